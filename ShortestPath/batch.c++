@@ -0,0 +1,311 @@
+//
+// Batch and server query modes
+//
+// The timetable and RAPTOR network are built once and then only read,
+// so any number of worker threads can search them at once.  The
+// reading thread hands query lines to the workers through a bounded
+// queue; each worker keeps its own Raptor_Scratch from query to query;
+// and answers are written in input order as soon as they are ready.
+//
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <deque>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <string.h>
+#include <errno.h>
+#ifndef _WIN32
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+#include "parse_gtfs.h"
+#include "raptor.h"
+#include "batch.h"
+
+using namespace std;
+
+//
+// How many queries may be read ahead of the oldest unanswered one,
+// per worker thread
+//
+const size_t QUERIES_IN_FLIGHT_PER_THREAD = 64;
+
+typedef struct _batch_query
+{
+    size_t number;
+    string line;
+} Batch_Query;
+
+Batch_Runner::Batch_Runner(const Timetable &timetable, const Raptor_Network &network, int max_transfers, unsigned threads)
+    : timetable(timetable), network(network), max_transfers(max_transfers), scratch(max(1u, threads))
+{
+}
+
+//
+// Reads one line of any length; false at end of file
+//
+static bool read_line(FILE *in, string &line)
+{
+    char buffer[4096];
+    line.clear();
+    while ( fgets(buffer, sizeof(buffer), in) ) {
+        line.append(buffer);
+        if ( line.back() == '\n' ) {
+            line.pop_back();
+            if ( !line.empty() && line.back() == '\r' ) {
+                line.pop_back();
+            }
+            return true;
+        }
+    }
+    return !line.empty();
+}
+
+static string answer_query(const Timetable &timetable, const Raptor_Network &network, int max_transfers,
+                           const Batch_Query &query, Raptor_Scratch &scratch, size_t &journeys_found)
+{
+    ostringstream answer;
+    answer << query.number << " ";
+
+    string fields = query.line;
+    replace(fields.begin(), fields.end(), ',', ' ');
+    istringstream parser(fields);
+    double start_lat, start_lon, dest_lat, dest_lon;
+    string time_of_day, extra;
+    if ( !(parser >> start_lat >> start_lon >> time_of_day >> dest_lat >> dest_lon) || (parser >> extra) ) {
+        answer << "error expected <source_lat> <source_lon> <timeofday> <dest_lat> <dest_lon>" << endl;
+        return answer.str();
+    }
+    Gtfs_Time start_time, latest_start_time;
+    if ( !parse_gtfs_time_window(time_of_day, start_time, latest_start_time) ) {
+        answer << "error unable to recognize time of day <" << time_of_day << ">" << endl;
+        return answer.str();
+    }
+
+    try {
+        auto journeys = latest_start_time != start_time ?
+            raptor_profile(timetable, network, start_lat, start_lon, start_time, latest_start_time,
+                           dest_lat, dest_lon, max_transfers, scratch) :
+            raptor_earliest_arrival(timetable, network, start_lat, start_lon, start_time,
+                                    dest_lat, dest_lon, max_transfers, scratch);
+        answer << journeys.size();
+        for ( const auto &journey: journeys ) {
+            answer << " " << format_gtfs_time(journey.depart) << "-" << format_gtfs_time(journey.arrive)
+                   << "/" << journey.transfers;
+        }
+        answer << endl;
+        journeys_found += journeys.size();
+    }
+    catch ( const exception &e ) {
+        answer.str("");
+        answer << query.number << " error " << e.what() << endl;
+    }
+    return answer.str();
+}
+
+Batch_Statistics Batch_Runner::run(FILE *in, FILE *out)
+{
+    chrono::time_point<chrono::system_clock> start = chrono::system_clock::now();
+
+    mutex lock;
+    condition_variable work_ready, room_ready;
+    deque<Batch_Query> queue;
+    bool end_of_input = false;
+    map<size_t, string> finished;     // Answers waiting for an earlier one
+    size_t next_to_write = 1;
+    bool writing = false;             // A worker is writing answers out
+    size_t next_to_read = 1;
+    size_t journeys_found = 0;
+    size_t in_flight_limit = QUERIES_IN_FLIGHT_PER_THREAD * scratch.size();
+
+    auto worker = [&](Raptor_Scratch &worker_scratch) {
+        size_t worker_journeys = 0;
+        for ( ;; ) {
+            Batch_Query query;
+            {
+                unique_lock<mutex> guard(lock);
+                work_ready.wait(guard, [&]() { return !queue.empty() || end_of_input; });
+                if ( queue.empty() ) {
+                    break;
+                }
+                query = move(queue.front());
+                queue.pop_front();
+            }
+
+            string answer = answer_query(timetable, network, max_transfers, query, worker_scratch, worker_journeys);
+
+            //
+            // Whoever finds answers ready to go out, with nobody else
+            // writing, writes them -- outside the lock, since a client
+            // that isn't reading yet can stall the write indefinitely
+            //
+            unique_lock<mutex> guard(lock);
+            finished.emplace(query.number, move(answer));
+            if ( writing ) {
+                continue;
+            }
+            writing = true;
+            for ( ;; ) {
+                vector<string> ready;
+                auto answers = finished.begin();
+                while ( answers != finished.end() && answers->first == next_to_write + ready.size() ) {
+                    ready.push_back(move(answers->second));
+                    answers = finished.erase(answers);
+                }
+                if ( ready.empty() ) {
+                    break;
+                }
+
+                guard.unlock();
+                for ( const auto &ready_answer: ready ) {
+                    fputs(ready_answer.c_str(), out);
+                }
+                fflush(out);
+                guard.lock();
+                next_to_write += ready.size();
+                room_ready.notify_one();
+            }
+            writing = false;
+        }
+        lock_guard<mutex> guard(lock);
+        journeys_found += worker_journeys;
+    };
+
+    vector<thread> workers;
+    for ( auto &worker_scratch: scratch ) {
+        workers.emplace_back(worker, ref(worker_scratch));
+    }
+
+    string line;
+    while ( read_line(in, line) ) {
+        size_t first = line.find_first_not_of(" \t");
+        if ( first == string::npos || line[first] == '#' ) {
+            continue;
+        }
+        unique_lock<mutex> guard(lock);
+        room_ready.wait(guard, [&]() { return next_to_read - next_to_write < in_flight_limit; });
+        queue.push_back(Batch_Query { next_to_read++, move(line) });
+        work_ready.notify_one();
+    }
+    {
+        lock_guard<mutex> guard(lock);
+        end_of_input = true;
+    }
+    work_ready.notify_all();
+    for ( auto &worker: workers ) {
+        worker.join();
+    }
+
+    chrono::duration<double> process_time = chrono::system_clock::now() - start;
+    return Batch_Statistics { next_to_read - 1, journeys_found, process_time.count() };
+}
+
+void print_batch_statistics(const Batch_Statistics &statistics, unsigned threads, ostream &out)
+{
+    out << "Answered " << statistics.queries << " queries (" << statistics.journeys << " journeys) in "
+        << statistics.seconds << " seconds on " << threads << " thread(s)";
+    if ( statistics.seconds > 0 ) {
+        out << ": " << statistics.queries / statistics.seconds << " queries/second";
+    }
+    out << "." << endl;
+}
+
+
+#ifndef _WIN32
+bool serve_batches(Batch_Runner &runner, string socket_path)
+{
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if ( socket_path.size() >= sizeof(address.sun_path) ) {
+        cerr << "Socket path <" << socket_path << "> is too long" << endl;
+        return false;
+    }
+    strcpy(address.sun_path, socket_path.c_str());
+
+    //
+    // Replace a socket left behind by an earlier server, but nothing else
+    //
+    struct stat existing;
+    if ( lstat(socket_path.c_str(), &existing) == 0 ) {
+        if ( !S_ISSOCK(existing.st_mode) ) {
+            cerr << "<" << socket_path << "> exists and is not a socket; not replacing it" << endl;
+            return false;
+        }
+        if ( unlink(socket_path.c_str()) < 0 ) {
+            cerr << "Unable to remove old socket <" << socket_path << ">: " << strerror(errno) << endl;
+            return false;
+        }
+    }
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if ( listener < 0 ) {
+        cerr << "Unable to create socket: " << strerror(errno) << endl;
+        return false;
+    }
+    if ( bind(listener, (sockaddr *) &address, sizeof(address)) < 0 || listen(listener, 16) < 0 ) {
+        cerr << "Unable to listen on <" << socket_path << ">: " << strerror(errno) << endl;
+        close(listener);
+        return false;
+    }
+
+    //
+    // A client hanging up early must not take the server down with it
+    //
+    signal(SIGPIPE, SIG_IGN);
+
+    cerr << "Listening on " << socket_path << " with " << runner.threads() << " thread(s)." << endl;
+    for ( ;; ) {
+        int connection = accept(listener, nullptr, nullptr);
+        if ( connection < 0 ) {
+            if ( errno == EINTR ) {
+                continue;
+            }
+            cerr << "Unable to accept connection: " << strerror(errno) << endl;
+            break;
+        }
+
+        //
+        // Connections are served one at a time, each by every worker
+        //
+        FILE *in = fdopen(connection, "r");
+        int out_connection = dup(connection);
+        FILE *out = out_connection >= 0 ? fdopen(out_connection, "w") : nullptr;
+        if ( in && out ) {
+            print_batch_statistics(runner.run(in, out), runner.threads(), cerr);
+        }
+        else {
+            cerr << "Unable to open connection: " << strerror(errno) << endl;
+        }
+        if ( in ) {
+            fclose(in);
+        }
+        else {
+            close(connection);
+        }
+        if ( out ) {
+            fclose(out);
+        }
+        else if ( out_connection >= 0 ) {
+            close(out_connection);
+        }
+    }
+    close(listener);
+    return false;
+}
+#else
+bool serve_batches(Batch_Runner &runner, string socket_path)
+{
+    cerr << "Unix domain sockets are not available on this platform" << endl;
+    return false;
+}
+#endif
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdio.h>
+#include <string>
+#include "parse_gtfs.h"
+#include "raptor.h"
+
+//
+// Answers many RAPTOR queries against one loaded timetable.  Each input
+// line is one query,
+//
+//     <source_lat> <source_lon> <timeofday> <dest_lat> <dest_lon>
+//
+// (blanks or commas between fields; blank lines and lines starting
+// with # are skipped), and produces one output line, in input order:
+//
+//     <query number> <journeys> [<depart>-<arrive>/<transfers> ...]
+//
+// or "<query number> error <reason>".  Query numbers count answered
+// and rejected queries from 1.  Results are written as soon as every
+// earlier query has been answered, so an interactive client sees each
+// answer as it is ready.
+//
+typedef struct _batch_statistics
+{
+    size_t queries;
+    size_t journeys;
+    double seconds;
+} Batch_Statistics;
+
+class Batch_Runner
+{
+public:
+    Batch_Runner(const Timetable &timetable, const Raptor_Network &network, int max_transfers, unsigned threads);
+
+    //
+    // Reads queries from in until end of file, answering them on the
+    // worker threads.  Returns once every answer has been written.
+    //
+    Batch_Statistics run(FILE *in, FILE *out);
+
+    unsigned threads() const { return scratch.size(); }
+
+private:
+    const Timetable &timetable;
+    const Raptor_Network &network;
+    int max_transfers;
+    std::vector<Raptor_Scratch> scratch;   // One per worker, kept from batch to batch
+};
+
+extern void print_batch_statistics(const Batch_Statistics &statistics, unsigned threads, std::ostream &out);
+
+//
+// Listen on a Unix domain socket, running one batch per connection
+// until the process is killed.  Returns false if the socket can't be
+// set up (or on platforms without Unix domain sockets).
+//
+extern bool serve_batches(Batch_Runner &runner, std::string socket_path);
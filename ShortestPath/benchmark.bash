@@ -0,0 +1,14 @@
+#
+# Build gtfs_benchmark.exe and run the offline benchmarks on synthetic
+# feeds (written under benchmark_data/).  Pass --iterations or --repeat
+# to trade precision for time.
+#
+cmd='g++ -std=c++17 -O2 benchmark.c++ synthetic_gtfs.c++ parse_gtfs.c++ parse_csv.c++ optimize_path.c++ stop_grid.c++ raptor.c++ -pthread -static-libgcc -static-libstdc++ -o gtfs_benchmark.exe'
+echo $cmd
+if ! $cmd; then
+    echo Compile failed with status $?
+    exit 1
+fi
+
+time ./gtfs_benchmark.exe micro "$@" ; echo Micro benchmarks exited with $?
+time ./gtfs_benchmark.exe scenarios "$@" ; echo Scenario benchmarks exited with $?
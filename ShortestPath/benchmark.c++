@@ -0,0 +1,399 @@
+//
+// Benchmarks for gtfs_route, runnable offline
+//
+//   gtfs_benchmark generate <folder> [feed options]
+//       Write a synthetic feed (see synthetic_gtfs.h) to folder.
+//
+//   gtfs_benchmark micro [--workdir folder] [--iterations count]
+//       Time the hot paths one call at a time, on a synthetic grid.
+//
+//   gtfs_benchmark scenarios [--workdir folder] [--repeat count]
+//       End-to-end queries mirroring mariposaCounty.bash and the MARTA
+//       scripts, on synthetic feeds laid out like those systems.
+//
+// Everything is seeded, so two runs on the same machine measure the
+// same work.  The running commentary of the hub engine is turned off
+// (Path_Counters::quiet) and its counters are reported instead.
+//
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <getopt.h>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <set>
+#include <math.h>
+#include <filesystem>
+#include <exception>
+#include "parse_gtfs.h"
+#include "parse_csv.h"
+#include "optimize_path.h"
+#include "raptor.h"
+#include "synthetic_gtfs.h"
+
+//
+// Results are folded into this so the compiler can't skip the work
+//
+volatile double benchmark_sink;
+
+//
+// Scenario queries are also run as RAPTOR profiles over this much
+// time from their start
+//
+const Gtfs_Time PROFILE_WINDOW_SECONDS = 3600;
+
+typedef struct _benchmark_scenario_query
+{
+    const char *name;
+    double start_lat;
+    double start_lon;
+    const char *time_of_day;
+    double dest_lat;
+    double dest_lon;
+    double route_buffer;
+} Benchmark_Query;
+
+typedef struct _benchmark_scenario
+{
+    const char *name;
+    Synthetic_Feed_Options feed;
+    std::vector<Benchmark_Query> queries;
+} Benchmark_Scenario;
+
+//
+// Stand-ins for the systems the bash scripts were written against: a
+// small rural system around Mariposa, and a big metro grid centered on
+// Atlanta.  Coordinates and buffers are the scripts' own.
+//
+static std::vector<Benchmark_Scenario> benchmark_scenarios()
+{
+    Synthetic_Feed_Options mariposa { 150, 300, 15, RADIAL, 37.49, -119.97, 2000, 2 };
+    Synthetic_Feed_Options marta { 9000, 30000, 40, GRID, 33.75, -84.39, 1500, 3 };
+    return {
+        { "mariposa", mariposa, {
+                { "hospital-to-chp",       37.5,    -119.978,  "11:00", 37.496,  -119.98,   4000 },
+                { "chp-to-body-shop",      37.496,  -119.98,   "11:00", 37.506,  -120.009,  9000 } } },
+        { "marta", marta, {
+                { "varsity-to-centennial", 33.8256, -84.3893,  "12:55", 33.7603, -84.3935,  1000 },
+                { "brookdale-to-callanwolde", 33.688, -84.42,  "12:55", 33.782,  -84.345,   1000 },
+                { "goldsmith-to-southfulton", 33.8108, -84.1829, "12:55", 33.5867, -84.5125, 1000 } } }
+    };
+}
+
+static double seconds_since(std::chrono::time_point<std::chrono::steady_clock> start)
+{
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+//
+// Calls body(i) for i in [0, iterations), after a short warm-up, and
+// reports the mean time per call
+//
+template <typename Body>
+static void run_micro_benchmark(const char *name, long iterations, Body body)
+{
+    for ( long i = 0; i < std::min(iterations, 1000L); i++ ) {
+        body(i);
+    }
+    auto start = std::chrono::steady_clock::now();
+    for ( long i = 0; i < iterations; i++ ) {
+        body(i);
+    }
+    double seconds = seconds_since(start);
+    std::cout << "  " << std::left << std::setw(44) << name << std::right << std::setw(10) << iterations << " calls "
+              << std::setw(12) << std::fixed << std::setprecision(1) << seconds / iterations * 1e9 << " ns/call"
+              << std::defaultfloat << std::setprecision(6) << std::endl;
+}
+
+//
+// Load a feed with the loader's own timing lines out of the way
+//
+static void load_quietly(const std::string &folder, Timetable &timetable)
+{
+    std::ostringstream discard;
+    auto saved = std::cout.rdbuf(discard.rdbuf());
+    try {
+        load_gtfs_system_data(folder, timetable);
+    }
+    catch ( ... ) {
+        std::cout.rdbuf(saved);
+        throw;
+    }
+    std::cout.rdbuf(saved);
+}
+
+static bool generate_feed(const Synthetic_Feed_Options &options, const std::string &folder)
+{
+    std::error_code error;
+    std::filesystem::create_directories(folder, error);
+    if ( !write_synthetic_feed(options, folder) ) {
+        std::cerr << "Unable to write synthetic feed to <" << folder << ">" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static int run_micro_benchmarks(const std::string &workdir, long iterations)
+{
+    std::string folder = workdir + "/micro";
+    Synthetic_Feed_Options options = default_synthetic_feed_options();
+    if ( !generate_feed(options, folder) ) {
+        return -1;
+    }
+    Timetable timetable;
+    load_quietly(folder, timetable);
+    std::cout << "Micro benchmarks (" << timetable.stops.size() << " stops, " << timetable.trips.size() << " trips, "
+              << timetable.stop_times.size() << " stop times):" << std::endl;
+
+    //
+    // CSV splitting, without and with quoted fields
+    //
+    std::string plain_line = "T1234,07:15:00,07:15:20,S4321,17";
+    std::string quoted_line = "S4321,4321,\"Stop 4321, Synthetic\",33.751234,-84.391234,\"say \"\"hi\"\"\"";
+    run_micro_benchmark("parse_quoted_csv_line (plain)", iterations, [&](long) {
+            benchmark_sink = benchmark_sink + parse_quoted_csv_line(plain_line).size();
+        });
+    run_micro_benchmark("parse_quoted_csv_line (quoted)", iterations, [&](long) {
+            benchmark_sink = benchmark_sink + parse_quoted_csv_line(quoted_line).size();
+        });
+    std::vector<std::string_view> fields;
+    std::string scratch;
+    run_micro_benchmark("split_quoted_csv_line (plain)", iterations, [&](long) {
+            split_quoted_csv_line(plain_line, fields, scratch);
+            benchmark_sink = benchmark_sink + fields.size();
+        });
+    run_micro_benchmark("split_quoted_csv_line (quoted)", iterations, [&](long) {
+            split_quoted_csv_line(quoted_line, fields, scratch);
+            benchmark_sink = benchmark_sink + fields.size();
+        });
+
+    //
+    // Distances and radius searches between stops of the feed
+    //
+    const auto &stops = timetable.stops;
+    size_t num_stops = stops.size();
+    run_micro_benchmark("dist_feet", iterations, [&](long i) {
+            const Stop &a = stops[i % num_stops], &b = stops[(i * 7919) % num_stops];
+            benchmark_sink = benchmark_sink + dist_feet(a.lat, a.lon, b.lat, b.lon);
+        });
+    for ( double distance: { 1000.0, 4000.0 } ) {
+        std::set<Stop_Index> found;
+        Path_Counters counters {};
+        std::string name = "add_stops_within_distance (" + std::to_string((int) distance) + " ft)";
+        run_micro_benchmark(name.c_str(), iterations / 10, [&](long i) {
+                const Stop &stop = stops[(i * 7919) % num_stops];
+                found.clear();
+                benchmark_sink = benchmark_sink + add_stops_within_distance(timetable, stop.lat, stop.lon, distance, found, &counters);
+            });
+    }
+
+    //
+    // Departures from a stop within a two-hour window
+    //
+    std::set<Trip_Index> trips;
+    Path_Counters counters {};
+    counters.quiet = true;
+    run_micro_benchmark("add_trips_containing_stop (2 hours)", iterations / 10, [&](long i) {
+            trips.clear();
+            Gtfs_Time after = (6 + i % 14) * 3600;
+            benchmark_sink = benchmark_sink + add_trips_containing_stop(timetable, (i * 7919) % num_stops, after, 120, trips, &counters);
+        });
+    std::cout << "  (" << counters.stop_times_scanned << " stop times scanned)" << std::endl;
+    return 0;
+}
+
+static int run_scenario_benchmarks(const std::string &workdir, int repeat)
+{
+    for ( const auto &scenario: benchmark_scenarios() ) {
+        std::string folder = workdir + "/" + scenario.name;
+        auto start = std::chrono::steady_clock::now();
+        if ( !generate_feed(scenario.feed, folder) ) {
+            return -1;
+        }
+        double generate_seconds = seconds_since(start);
+
+        start = std::chrono::steady_clock::now();
+        Timetable timetable;
+        load_quietly(folder, timetable);
+        double load_seconds = seconds_since(start);
+
+        std::cout << std::endl << "Scenario " << scenario.name << ": " << timetable.stops.size() << " stops, "
+                  << timetable.trips.size() << " trips, " << timetable.stop_times.size() << " stop times; generated in "
+                  << generate_seconds << " s, loaded in " << load_seconds << " s." << std::endl;
+
+        for ( const auto &query: scenario.queries ) {
+            Gtfs_Time start_time = parse_gtfs_time(query.time_of_day);
+
+            //
+            // Hub expansion, with its summary lines discarded
+            //
+            double hub_best = HUGE_VAL, hub_total = 0;
+            int crux_points = 0;
+            Path_Counters counters {};
+            for ( int run = 0; run < repeat; run++ ) {
+                counters = Path_Counters {};
+                counters.quiet = true;
+                std::ostringstream discard;
+                auto saved = std::cout.rdbuf(discard.rdbuf());
+                start = std::chrono::steady_clock::now();
+                crux_points = optimize_paths(timetable, query.start_lat, query.start_lon, query.dest_lat, query.dest_lon,
+                                             start_time, query.route_buffer, 15.0, 120, 960, &counters);
+                double seconds = seconds_since(start);
+                std::cout.rdbuf(saved);
+                hub_best = std::min(hub_best, seconds);
+                hub_total += seconds;
+            }
+            std::cout << "  " << std::left << std::setw(26) << query.name << std::right
+                      << " hub:    best " << hub_best * 1e3 << " ms, mean " << hub_total / repeat * 1e3 << " ms, "
+                      << crux_points << " transfer points" << std::endl;
+            std::cout << "  " << std::setw(26) << "" << "         " << counters.stop_times_scanned << " stop times scanned, "
+                      << counters.radius_queries << " radius queries, " << counters.expansions << " expansions ("
+                      << counters.max_depth << " deep), sets up to " << counters.max_stop_set << " stops / "
+                      << counters.max_trip_set << " trips" << std::endl;
+
+            //
+            // RAPTOR, counting the network build separately
+            //
+            start = std::chrono::steady_clock::now();
+            Raptor_Network network;
+            build_raptor_network(timetable, query.route_buffer, 15.0, network);
+            double build_seconds = seconds_since(start);
+            Raptor_Scratch scratch;
+            double raptor_best = HUGE_VAL, raptor_total = 0;
+            size_t journeys = 0;
+            for ( int run = 0; run < repeat; run++ ) {
+                start = std::chrono::steady_clock::now();
+                journeys = raptor_earliest_arrival(timetable, network, query.start_lat, query.start_lon, start_time,
+                                                   query.dest_lat, query.dest_lon, 3, scratch).size();
+                double seconds = seconds_since(start);
+                raptor_best = std::min(raptor_best, seconds);
+                raptor_total += seconds;
+            }
+            std::cout << "  " << std::setw(26) << "" << " raptor: best " << raptor_best * 1e3 << " ms, mean "
+                      << raptor_total / repeat * 1e3 << " ms, " << journeys << " journeys (network built in "
+                      << build_seconds * 1e3 << " ms)" << std::endl;
+
+            double profile_best = HUGE_VAL, profile_total = 0;
+            for ( int run = 0; run < repeat; run++ ) {
+                start = std::chrono::steady_clock::now();
+                journeys = raptor_profile(timetable, network, query.start_lat, query.start_lon,
+                                          start_time, start_time + PROFILE_WINDOW_SECONDS,
+                                          query.dest_lat, query.dest_lon, 3, scratch).size();
+                double seconds = seconds_since(start);
+                profile_best = std::min(profile_best, seconds);
+                profile_total += seconds;
+            }
+            std::cout << "  " << std::setw(26) << "" << " profile over " << PROFILE_WINDOW_SECONDS / 60 << " minutes: best "
+                      << profile_best * 1e3 << " ms, mean " << profile_total / repeat * 1e3 << " ms, "
+                      << journeys << " journeys" << std::endl;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    static struct option benchmark_options[]
+        {
+            {"workdir", required_argument, 0, 'w'},
+            {"iterations", required_argument, 0, 'i'},
+            {"repeat", required_argument, 0, 'n'},
+            {"stops", required_argument, 0, 's'},
+            {"trips", required_argument, 0, 'p'},
+            {"stopspertrip", required_argument, 0, 'l'},
+            {"topology", required_argument, 0, 'g'},
+            {"spacing", required_argument, 0, 'd'},
+            {"seed", required_argument, 0, 'r'},
+            {0, 0, 0, 0}
+        };
+
+    if ( argc < 2 ) {
+        std::cerr << "Usage: gtfs_benchmark generate <folder> [--stops n] [--trips n] [--stopspertrip n] [--topology grid|radial] [--spacing feet] [--seed n]" << std::endl;
+        std::cerr << "       gtfs_benchmark micro [--workdir folder] [--iterations n]" << std::endl;
+        std::cerr << "       gtfs_benchmark scenarios [--workdir folder] [--repeat n]" << std::endl;
+        return -1;
+    }
+    std::string command = argv[1];
+
+    int opt;
+    int option_index = 0;
+    std::string workdir { "benchmark_data" };
+    long iterations { 1000000 };
+    int repeat { 5 };
+    Synthetic_Feed_Options feed = default_synthetic_feed_options();
+    std::string topology { "grid" };
+
+    optind = 2;
+    while ((opt = getopt_long(argc, argv, "w:i:n:s:p:l:g:d:r:",
+                              benchmark_options, &option_index)) != -1) {
+        switch(opt) {
+        case 'w':
+            workdir = optarg;
+            break;
+
+        case 'i':
+            iterations = std::max(10L, strtol(optarg, nullptr, 10));
+            break;
+
+        case 'n':
+            repeat = std::max(1L, strtol(optarg, nullptr, 10));
+            break;
+
+        case 's':
+            feed.stops = strtol(optarg, nullptr, 10);
+            break;
+
+        case 'p':
+            feed.trips = strtol(optarg, nullptr, 10);
+            break;
+
+        case 'l':
+            feed.stops_per_trip = strtol(optarg, nullptr, 10);
+            break;
+
+        case 'g':
+            topology = optarg;
+            break;
+
+        case 'd':
+            feed.stop_spacing = strtod(optarg, nullptr);
+            break;
+
+        case 'r':
+            feed.seed = strtoull(optarg, nullptr, 10);
+            break;
+
+        default:
+            return -1;
+        }
+    }
+
+    try {
+        if ( command == "generate" ) {
+            if ( argc - optind != 1 || (topology != "grid" && topology != "radial") ) {
+                std::cerr << "generate needs a folder, and --topology must be grid or radial" << std::endl;
+                return -1;
+            }
+            feed.topology = topology == "grid" ? GRID : RADIAL;
+            return generate_feed(feed, argv[optind]) ? 0 : -1;
+        }
+        if ( command == "micro" ) {
+            return run_micro_benchmarks(workdir, iterations);
+        }
+        if ( command == "scenarios" ) {
+            return run_scenario_benchmarks(workdir, repeat);
+        }
+    }
+    catch ( const std::exception &e ) {
+        std::cerr << "Benchmark failed with Exception: " << e.what() << std::endl;
+        return -5;
+    }
+
+    std::cerr << "Unknown benchmark command <" << command << ">; expected generate, micro or scenarios" << std::endl;
+    return -1;
+}
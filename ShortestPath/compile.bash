@@ -1,5 +1,5 @@
 #/cygdrive/c/Miles/RailsInstaller/DevKit/mingw/bin/g++ -std=c++11 main.C -static-libgcc -static-libstdc++ -o gtfs_route.exe
-cmd='g++ -std=c++11 main.c++ parse_gtfs.c++ parse_csv.c++ optimize_path.c++ -static-libgcc -static-libstdc++ -o gtfs_route.exe'
+cmd='g++ -std=c++17 -O2 main.c++ parse_gtfs.c++ parse_csv.c++ optimize_path.c++ stop_grid.c++ raptor.c++ snapshot.c++ batch.c++ -pthread -static-libgcc -static-libstdc++ -o gtfs_route.exe'
 echo $cmd
 if $cmd; then
     echo Compile succeeded.
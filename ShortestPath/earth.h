@@ -0,0 +1,9 @@
+#pragma once
+
+//
+// Shared by dist_feet() and the stop grid, which must agree on them to
+// the last bit for the grid to find exactly the stops dist_feet() would
+//
+const double EARTH_RADIUS_KM = 6371;
+const double EARTH_RADIUS_FEET = EARTH_RADIUS_KM * 3280.84;   // Mean radius
+const double TO_RAD = 3.1415926536 / 180;
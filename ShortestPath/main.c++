@@ -3,8 +3,14 @@
 #include <cstdlib>
 #include <string>
 #include <exception>
+#include <chrono>
+#include <thread>
+#include <stdio.h>
 #include "parse_gtfs.h"
 #include "optimize_path.h"
+#include "raptor.h"
+#include "snapshot.h"
+#include "batch.h"
 
 //
 // Overarching priorities:
@@ -27,6 +33,13 @@ int main(int argc, char **argv)
             {"timebuff", required_argument, 0, 't'},
             {"routebuff", required_argument, 0, 'r'},
             {"verbose", no_argument, 0, 'v'},
+            {"quiet", no_argument, 0, 'q'},
+            {"engine", required_argument, 0, 'e'},
+            {"maxtransfers", required_argument, 0, 'x'},
+            {"compile", no_argument, 0, 'c'},
+            {"batch", required_argument, 0, 'b'},
+            {"listen", required_argument, 0, 'l'},
+            {"threads", required_argument, 0, 'j'},
             {0, 0, 0, 0}
         };
 
@@ -36,14 +49,23 @@ int main(int argc, char **argv)
     double route_buffer { 1000.0L };
     int longest_initial_wait { 120 };
     int longest_acceptable_time { 960 };
+    int max_transfers { 3 };
+    std::string engine { "hub" };
+    bool engine_given = false;
         
     double start_lat, start_lon, dest_lat, dest_lon;
     std::string time_of_day;
+    Gtfs_Time start_time, latest_start_time;
     char *remainder;
     std::string gtfs_dir;
     bool verbose = false;
+    bool quiet = false;
+    bool compile = false;
+    std::string batch_file;
+    std::string socket_path;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
 
-    while ((opt = getopt_long(argc, argv, "r:t:v",
+    while ((opt = getopt_long(argc, argv, "r:t:vqe:x:cb:l:j:",
                               gtfs_route_options, &first_mandatory_option)) != -1) {
         switch(opt) {
         case 'r':
@@ -57,7 +79,100 @@ int main(int argc, char **argv)
         case 'v':
             verbose = true;
             break;
+
+        case 'q':
+            quiet = true;
+            break;
+
+        case 'e':
+            engine = optarg;
+            engine_given = true;
+            break;
+
+        case 'x':
+            max_transfers = strtol(optarg, &remainder, 10);
+            break;
+
+        case 'c':
+            compile = true;
+            break;
+
+        case 'b':
+            batch_file = optarg;
+            break;
+
+        case 'l':
+            socket_path = optarg;
+            break;
+
+        case 'j':
+            threads = std::max(1L, strtol(optarg, &remainder, 10));
+            break;
+        }
+    }
+
+    //
+    // --compile with just a directory writes the snapshot and stops
+    //
+    if ( compile && argc - optind == 1 ) {
+        Timetable timetable;
+        try {
+            load_gtfs_timetable(argv[optind], compile, timetable);
+        }
+        catch ( const std::exception &e ) {
+            std::cerr << "Application failed with Exception: " << e.what() << std::endl;
+            return -5;
         }
+        return 0;
+    }
+
+    //
+    // Batch and server modes: load once, then answer queries (RAPTOR
+    // only) from a file, stdin, or a Unix domain socket
+    //
+    if ( !batch_file.empty() || !socket_path.empty() ) {
+        if ( argc - optind != 1 ) {
+            std::cerr << "--batch and --listen take just the GTFS directory as an argument" << std::endl;
+            return -1;
+        }
+        if ( engine_given && engine != "raptor" ) {
+            std::cerr << "--batch and --listen only answer with --engine raptor" << std::endl;
+            return -1;
+        }
+
+        //
+        // stdout carries nothing but answers, one line per query, so
+        // the loader's timing lines go to stderr with the other
+        // diagnostics
+        //
+        std::cout.rdbuf(std::cerr.rdbuf());
+
+        Timetable timetable;
+        Raptor_Network network;
+        try {
+            load_gtfs_timetable(argv[optind], compile, timetable);
+            build_raptor_network(timetable, route_buffer, time_buffer, network);
+        }
+        catch ( const std::exception &e ) {
+            std::cerr << "Application failed with Exception: " << e.what() << std::endl;
+            return -5;
+        }
+
+        Batch_Runner runner(timetable, network, max_transfers, threads);
+        if ( !socket_path.empty() ) {
+            return serve_batches(runner, socket_path) ? 0 : -1;
+        }
+
+        FILE *in = batch_file == "-" ? stdin : fopen(batch_file.c_str(), "r");
+        if ( !in ) {
+            std::cerr << "Error opening file <" << batch_file << ">" << std::endl;
+            return -1;
+        }
+        print_batch_statistics(runner.run(in, stdout), runner.threads(), std::cerr);
+        if ( in != stdin ) {
+            fclose(in);
+        }
+        return 0;
     }
 
     //
@@ -67,6 +182,10 @@ int main(int argc, char **argv)
         std::cerr << "6 Arguments required" << std::endl;
         return -1;
     }
+    if ( engine != "hub" && engine != "raptor" ) {
+        std::cerr << "Unknown routing engine <" << engine << ">; expected hub or raptor" << std::endl;
+        return -1;
+    }
 
     gtfs_dir = argv[optind++];
     start_lat = strtod(argv[optind++], &remainder);
@@ -74,6 +193,21 @@ int main(int argc, char **argv)
     time_of_day = argv[optind++];
     dest_lat = strtod(argv[optind++], &remainder);
     dest_lon = strtod(argv[optind++], &remainder);
+
+    if ( !parse_gtfs_time_window(time_of_day, start_time, latest_start_time) ) {
+        std::cerr << "Unable to recognize time of day <" << time_of_day << ">; expected hh:mm or hh:mm-hh:mm" << std::endl;
+        return -1;
+    }
+
+    //
+    // A departure window asks for every worthwhile journey leaving in
+    // it, which only RAPTOR can answer
+    //
+    bool profile = latest_start_time != start_time;
+    if ( profile && engine != "raptor" ) {
+        std::cerr << "A departure window <" << time_of_day << "> needs --engine raptor" << std::endl;
+        return -1;
+    }
     
     std::cout << std::endl << "INPUT PARAMETERS:   " << std::endl;
     std::cout << "  GTFS Data Directory:      " << gtfs_dir << std::endl;
@@ -82,15 +216,15 @@ int main(int argc, char **argv)
     std::cout << "  Destination:              (" << dest_lat << ", " << dest_lon << ")." << std::endl;
     std::cout << "  Maximum walking distance: " << route_buffer << " feet" << std::endl;
     std::cout << "  Longest delay without risking connection: " << time_buffer << " minutes." << std::endl;
+    std::cout << "  Routing engine:           " << engine << std::endl;
+    if ( engine == "raptor" ) {
+        std::cout << "  Most transfers allowed:   " << max_transfers << std::endl;
+    }
 
     
-    std::vector<Agency> agencies;
-    std::vector<Route> routes;
-    std::unordered_map<std::string, Stop> stops;
-    std::vector<Stop_Time> stop_times;
-    std::vector<Trip> trips;
+    Timetable timetable;
     try {
-        load_gtfs_system_data(gtfs_dir, agencies, routes, stops, stop_times, trips);
+        load_gtfs_timetable(gtfs_dir, compile, timetable);
     }
     catch ( const std::exception &e ) {
         std::cerr << "Application failed with Exception: " << e.what() << std::endl;
@@ -99,21 +233,20 @@ int main(int argc, char **argv)
 
     if ( verbose ) {
         std::cout << std::endl << "AGENCY(IES): " << std::endl;
-        for ( auto agency: agencies ) {
+        for ( const auto &agency: timetable.agencies ) {
             std::cout << "  GTFS System ID:    " << agency.id << std::endl;
             std::cout << "  GTFS System Name:  " << agency.name << std::endl;
             std::cout << "  GTFS System Email: " << agency.email << std::endl;
         }
         std::cout << std::endl << "ROUTES: " << std::endl;
-        for ( auto route: routes ) {
+        for ( const auto &route: timetable.routes ) {
             std::cout << "  Route ID:    " << route.id << std::endl;
             std::cout << "  Short Name:  " << route.short_name << std::endl;
             std::cout << "  Long Name:   " << route.long_name << std::endl;
             std::cout << "  Description: " << route.desc << std::endl;
         }
         std::cout << std::endl << "STOPS: " << std::endl;
-        for ( auto stop_pair: stops ) {
-            auto stop = stop_pair.second;
+        for ( const auto &stop: timetable.stops ) {
             std::cout << "  Stop ID:       " << stop.id << std::endl;
             std::cout << "  Stop Code:     " << stop.code << std::endl;
             std::cout << "  Stop Name:     " << stop.name << std::endl;
@@ -123,10 +256,47 @@ int main(int argc, char **argv)
 
 
     try {
-        int num_paths = optimize_paths(trips, stops, stop_times, routes,
+        int num_paths;
+        if ( engine == "raptor" ) {
+            std::chrono::time_point<std::chrono::system_clock> start, end;
+            std::chrono::duration<double> process_time;
+
+            start = std::chrono::system_clock::now();
+            Raptor_Network network;
+            build_raptor_network(timetable, route_buffer, time_buffer, network);
+            end = std::chrono::system_clock::now();
+            process_time = end - start;
+            std::cout << "Built RAPTOR network (" << network.num_patterns() << " patterns, "
+                      << network.footpath_stops.size() << " footpaths) in " << process_time.count() << " seconds." << std::endl;
+
+            start = end;
+            Raptor_Scratch scratch;
+            auto journeys = profile ?
+                raptor_profile(timetable, network, start_lat, start_lon, start_time, latest_start_time,
+                               dest_lat, dest_lon, max_transfers, scratch) :
+                raptor_earliest_arrival(timetable, network, start_lat, start_lon, start_time,
+                                        dest_lat, dest_lon, max_transfers, scratch);
+            end = std::chrono::system_clock::now();
+            process_time = end - start;
+            std::cout << "RAPTOR search took " << process_time.count() << " seconds." << std::endl;
+
+            for ( const auto &journey: journeys ) {
+                print_journey(timetable, journey, std::cout);
+            }
+            num_paths = journeys.size();
+        }
+        else {
+            Path_Counters counters {};
+            counters.quiet = quiet;
+            num_paths = optimize_paths(timetable,
                                        start_lat, start_lon, dest_lat, dest_lon,
-                                       time_of_day, route_buffer, time_buffer,
-                                       longest_initial_wait, longest_acceptable_time);
+                                       start_time, route_buffer, time_buffer,
+                                       longest_initial_wait, longest_acceptable_time, &counters);
+            std::cout << "Scanned " << counters.stop_times_scanned << " stop times (" << counters.untimed_stop_times << " untimed), "
+                      << counters.radius_queries << " radius queries finding " << counters.stops_found << " stops, "
+                      << counters.expansions << " expansions, " << counters.max_depth << " deep, "
+                      << "at most " << counters.max_stop_set << " stops and " << counters.max_trip_set << " trips." << std::endl;
+        }
         cout << num_paths << " paths identified." << endl;
     }
     catch ( const std::exception &e ) {
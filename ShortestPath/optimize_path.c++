@@ -1,15 +1,14 @@
-#define _XOPEN_SOURCE 700
-#undef __STRICT_ANSI__
 #include <iostream>
 #include <vector>
 #include <set>
 #include <math.h>
-#include <ctime>
 #include <iterator>
 #include <algorithm>
 #include <chrono>
 #include "parse_gtfs.h"
 #include "optimize_path.h"
+#include "stop_grid.h"
+#include "earth.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -27,12 +26,11 @@ using namespace std;
 // the results of haversine, but in feet for every day use
 //
 #ifdef TEST_ROSETTA
-#define R 6371
+#define R EARTH_RADIUS_KM
 #else
-#define R 6371 * 3280.84
+#define R EARTH_RADIUS_FEET
 #endif
 
-#define TO_RAD (3.1415926536 / 180)
 double dist_feet(double th1, double ph1, double th2, double ph2)
 {
 	double dx, dy, dz;
@@ -67,62 +65,6 @@ int main()
 }
 #endif
 
-#ifndef STRPTIME_AVAILABLE
-//
-// I couldn't find strptime or any suitable alternative in MinGW
-// 4.7.2, so created a limited version.  Hopefully, this will
-// fail to compile if there is a real strptime() available
-//
-extern "C"
-{
-    char *strptime(const char *time_of_day, const char *format, struct tm *tm)
-    {
-        char *remainder;
-        int hours, minutes;
-        time_t now;
-
-        hours = strtol(time_of_day, &remainder, 10);
-        if ( hours < 0 || hours > 24 || remainder == (char *) NULL || *remainder != ':' )
-            return NULL;
-
-        remainder++; // Skip over ':'
-        minutes = strtol(remainder, &remainder, 10);
-        if ( minutes < 0 || minutes > 60 )
-            return NULL;
-        
-        if ( tm != (struct tm *) NULL ) {
-            time(&now);
-            localtime_s(tm, &now);
-            tm->tm_hour = hours;
-            tm->tm_min = minutes;
-        }
-
-        return remainder;
-    }
-}
-#endif    
-
-long difftime_in_minutes(string a, string b)
-{
-    struct tm atm, btm;
-    time_t atime, btime;
-    double diff_in_secs;
-
-    if ( strptime(a.c_str(), "%r", &atm) == NULL ) {
-        throw invalid_time_stamp();
-    }
-    if ( strptime(b.c_str(), "%r", &btm) == NULL ) {
-        throw invalid_time_stamp();
-    }
-    
-    atime = mktime(&atm);
-    btime = mktime(&btm);
-    diff_in_secs = difftime(btime, atime);
-    
-    return ceil(diff_in_secs / 60.0);
-}
-
-
 //
 // PATH OPTIMIZATION
 // 
@@ -185,107 +127,118 @@ long difftime_in_minutes(string a, string b)
 //
 // Find stops within distance of a target point
 //
-int add_stops_within_distance(unordered_map<string, Stop> &stops, double lat, double lon, double distance,
-                               /* in/out */ set<string> &stops_within_distance)
+//
+// Whether to print the running commentary
+//
+static bool chatty(const Path_Counters *counters)
+{
+    return counters == nullptr || !counters->quiet;
+}
+
+int add_stops_within_distance(const Timetable &timetable, double lat, double lon, double distance,
+                              /* in/out */ set<Stop_Index> &stops_within_distance,
+                              /* in/out */ Path_Counters *counters)
 {
     int count_before = stops_within_distance.size();
 
     //
     // Accumulate a list of unique stops within a certain distance of
-    // a point.
+    // a point.  The stop grid (see stop_grid.c++) only looks at stops
+    // in the neighborhood, instead of every stop in the system.
     //
-    // Comparing the various incantations of for_each, and the
-    // exercise of capturing the correct type of references for the
-    // lambda, I have to say the code with range-based for is much
-    // more readable.  The payoff might be there for other algorithms,
-    // or for parallelized algorithms in C++ 17.
-    //
-#if 0
-    for_each(stops.begin(), stops.end(), [&stops_within_distance,lat,lon,distance](const pair <const string, Stop> &stop_key_value) {
-    //for_each(stops.begin(), stops.end(), [&stops_within_distance,lat,lon,distance](const std::unordered_map<string,Stop>::value_type &stop_key_value) {
-            if ( dist_feet(lat, lon, stop_key_value.second.lat, stop_key_value.second.lon) < distance ) {
-                stops_within_distance.insert(stop_key_value.second.id);
-            }
-        });
-#else
-    // for ( const pair <const string, Stop> stop_key_value : stops ) {
-    for (const auto stop_key_value: stops) {
-        if ( dist_feet(lat, lon, stop_key_value.second.lat, stop_key_value.second.lon) < distance ) {
-            stops_within_distance.insert(stop_key_value.second.id);
-        }
+    vector<Stop_Index> nearby_stops;
+    find_stops_within_distance(timetable, lat, lon, distance, nearby_stops);
+    if ( counters ) {
+        counters->radius_queries++;
+        counters->stops_found += nearby_stops.size();
     }
-#endif
-            
+    stops_within_distance.insert(nearby_stops.begin(), nearby_stops.end());
 
     return stops_within_distance.size() - count_before;
 }
 
-int add_trips_containing_stop(vector<Trip> &trips, vector<Stop_Time> &stop_times,
-                              const string &stop_id, const string *after_time_of_day, long time_box,
-                              /* in/out */ set<string> &trips_containing_stop)
+int add_trips_containing_stop(const Timetable &timetable, Stop_Index stop,
+                              Gtfs_Time after_time_of_day, long time_box,
+                              /* in/out */ set<Trip_Index> &trips_containing_stop,
+                              /* in/out */ Path_Counters *counters)
 {
     int count_before = trips_containing_stop.size();
-    struct tm tm;
-    
-    int trips_later_today = 0;
-    cout << "Searching for trips that hit stop " << stop_id << ":" << endl;
-    for ( auto stop_time: stop_times ) {
-        if ( stop_id == stop_time.stop ) {
-            //
-            // Validate arrival time.  Must be valid time stamp, and within
-            // appropriate range of optional time-of-day constraint
-            //
-            try {
-                //
-                // Skip trips that have already happened today, and
-                // those arriving outside the specified time box
-                //
-                if ( after_time_of_day ) {
-                    int minutes_away = difftime_in_minutes(*after_time_of_day, stop_time.arrive);
-                    if ( minutes_away < 0 || minutes_away > time_box ) {
-                        continue;
-                    }
-                }
-                else {
-                    if ( strptime(stop_time.arrive.c_str(), "%r", &tm) == NULL ) {
-                        throw invalid_time_stamp();
-                    }
-                }
-            }
-            
-            catch ( invalid_time_stamp(its) ) {
-                //
-                // Some stops do not contain actual arrival or departure times
-                // Perhaps there is something that could be done with them,
-                // but without understanding the context, we must ignore these
-                //
-                cout << "  TRIP " << stop_time.trip << " covers this stop, but the published arrival time <" << stop_time.arrive << "> is unintelligible." << endl;
-                continue;
-            }
-        
-            //
-            // Maintain list of qualifying trips as a set of trip ids
-            // (strings) This eliminates duplicates, and avoids
-            // copying entire trip structure.  We might have to search
-            // for the trip later, but if that becomes important to
-            // performance, we could convert the trips vector into an
-            // unordered_map
-            //
-            cout << "  Adding trip: " << stop_time.trip << " for stop departing at " << stop_time.depart << endl;
-            trips_containing_stop.insert(stop_time.trip);
+    const Stop_Times &stop_times = timetable.stop_times;
+    const auto &depart = stop_times.depart;
+
+    bool verbose = chatty(counters);
+    if ( verbose ) {
+        cout << "Searching for trips that hit stop " << timetable.stops[stop].id << ":" << endl;
+    }
+
+    //
+    // This stop's rows are sorted by departure time, so the window of
+    // interest is found by binary search rather than by testing every
+    // row.  Rows with no intelligible time (NO_TIME) sit at the end.
+    //
+    auto first = timetable.stop_departures.begin() + timetable.stop_offsets[stop];
+    auto last = timetable.stop_departures.begin() + timetable.stop_offsets[stop + 1];
+    auto departs_before = [&depart](uint32_t row, Gtfs_Time time) { return depart[row] < time; };
+    auto untimed = lower_bound(first, last, NO_TIME, departs_before);
+
+    //
+    // Skip trips that have already left by the time we get there, and
+    // those leaving outside the specified time box
+    //
+    if ( after_time_of_day != NO_TIME ) {
+        first = lower_bound(first, untimed, after_time_of_day, departs_before);
+        last = lower_bound(first, untimed, after_time_of_day + time_box * 60 + 1, departs_before);
+    }
+    else {
+        last = untimed;
+    }
+
+    auto stop_end = timetable.stop_departures.begin() + timetable.stop_offsets[stop + 1];
+    if ( counters ) {
+        counters->stop_times_scanned += last - first;
+        counters->untimed_stop_times += stop_end - untimed;
+    }
+
+    for ( auto slot = first; slot != last; slot++ ) {
+        uint32_t row = *slot;
+        Trip_Index trip = stop_times.trip[row];
+
+        //
+        // Maintain list of qualifying trips as a set of trip indexes.
+        // This eliminates duplicates, and avoids copying entire trip
+        // structure.
+        //
+        if ( verbose ) {
+            cout << "  Adding trip: " << timetable.trips[trip].id << " for stop departing at " << format_gtfs_time(depart[row]) << endl;
         }
+        trips_containing_stop.insert(trip);
+    }
+
+    //
+    // Some stops do not contain actual arrival or departure times
+    // Perhaps there is something that could be done with them,
+    // but without understanding the context, we must ignore these
+    //
+    for ( auto slot = untimed; verbose && slot != stop_end; slot++ ) {
+        cout << "  TRIP " << timetable.trips[stop_times.trip[*slot]].id << " covers this stop, but the published departure time is unintelligible." << endl;
     }
-    
+
     return trips_containing_stop.size() - count_before;
 }
 
-int expand_network_from(vector<Trip> &trips, unordered_map<string, Stop> &stops,
-                        vector<Stop_Time> &stop_times, double lat, double lon, int iterations,
-                        string start_time_of_day, long time_box, long recursive_time_box,
+int expand_network_from(const Timetable &timetable, double lat, double lon, int iterations,
+                        Gtfs_Time start_time_of_day, long time_box, long recursive_time_box,
                         double route_buffer, double time_buffer,
-                        /* in/out */ set<string> &stop_ids, /* in/out */ set<string> &trip_ids,
-                        /* in/out */ set<string> &expanded_stops, /* in/out */ set<string> &expanded_trips)
+                        /* in/out */ set<Stop_Index> &stop_ids, /* in/out */ set<Trip_Index> &trip_ids,
+                        /* in/out */ set<Stop_Index> &expanded_stops, /* in/out */ set<Trip_Index> &expanded_trips,
+                        /* in/out */ Path_Counters *counters)
 {
+    bool verbose = chatty(counters);
+    if ( counters ) {
+        counters->expansions++;
+        counters->max_depth = max(counters->max_depth, ++counters->depth);
+    }
+
     //
     // Generate list of unique trips that stop near the source
     // position within the timebox.  For the lambda, specify the
@@ -294,8 +247,8 @@ int expand_network_from(vector<Trip> &trips, unordered_map<string, Stop> &stops,
     // probably does "the right thing", but compilers tend to help
     // those who help themselves.
     // 
-    int num_new_stops = add_stops_within_distance(stops, lat, lon, route_buffer, stop_ids);
-    if ( num_new_stops > 0 ) {
+    int num_new_stops = add_stops_within_distance(timetable, lat, lon, route_buffer, stop_ids, counters);
+    if ( num_new_stops > 0 && verbose ) {
         cout << "Found " << num_new_stops << " new stops within " << route_buffer << " feet of (" << lat << ", " << lon << ")." << endl;
     }
 
@@ -313,14 +266,16 @@ int expand_network_from(vector<Trip> &trips, unordered_map<string, Stop> &stops,
         // Last lambda standing
         //
         for_each(stop_ids.begin(), stop_ids.end(),
-                 [&expanded_stops, &trips, &stop_times, start_time_of_day, time_box, &trip_ids](const string &stop_id) {
-                     auto insert_result = expanded_stops.insert(stop_id);
+                 [&expanded_stops, &timetable, start_time_of_day, time_box, &trip_ids, counters](Stop_Index stop) {
+                     auto insert_result = expanded_stops.insert(stop);
                      if ( insert_result.second ) {
-                         add_trips_containing_stop(trips, stop_times, stop_id, &start_time_of_day, time_box, trip_ids);
+                         add_trips_containing_stop(timetable, stop, start_time_of_day, time_box, trip_ids, counters);
                      }
                  });
         num_new_trips = trip_ids.size() - num_trips_before;
-        cout << "Found " << num_new_trips << " new trips that hit one of those stops " << route_buffer << " feet of destination." << endl;
+        if ( verbose ) {
+            cout << "Found " << num_new_trips << " new trips that hit one of those stops " << route_buffer << " feet of destination." << endl;
+        }
     }
 
     //
@@ -334,50 +289,56 @@ int expand_network_from(vector<Trip> &trips, unordered_map<string, Stop> &stops,
     // intentionally try to narrow down the field.
     //
 
+    if ( counters ) {
+        counters->max_stop_set = max(counters->max_stop_set, stop_ids.size());
+        counters->max_trip_set = max(counters->max_trip_set, trip_ids.size());
+    }
+
     //
     // Do not recurse further if we are on the last iteration, or if we
     // found no new data on this iteration
     //
-    if ( (num_new_trips == 0 && num_new_stops == 0) || iterations == 0 )
+    if ( (num_new_trips == 0 && num_new_stops == 0) || iterations == 0 ) {
+        if ( counters ) {
+            counters->depth--;
+        }
         return num_new_trips;
+    }
 
-    for ( const auto trip_id: trip_ids ) {
+    for ( Trip_Index trip: trip_ids ) {
         //
         // "Insert" trip id into the list of trips we've already expanded
         // If the insert fails, then we don't need to revisit this trip
         //
-        auto insert_result = expanded_trips.insert(trip_id);
+        auto insert_result = expanded_trips.insert(trip);
         if ( insert_result.second ) {
             //
-            // Find all stops related to this trip (using stop_times
-            // list as a guide) and expand the network recursively
+            // Find all stops related to this trip (its slice of the
+            // stop_times table) and expand the network recursively
             // using the location of those stops
             //
-            for ( const auto stop_time: stop_times ) {
-                if ( stop_time.trip == trip_id ) {
-                    const auto stop_key_value = stops.find(stop_time.stop);
-                    if ( stop_key_value == stops.end() ) {
-                        cerr << "UNEXPECTED REFERENCE to non-existent stop " << stop_time.stop << " in trip " << trip_id << ". Cannot resolve this part of network further." << endl;
-                    }
-                    else {
-                        expand_network_from(trips, stops, stop_times,
-                                            stop_key_value->second.lat, stop_key_value->second.lon, iterations,
-                                            start_time_of_day, recursive_time_box, recursive_time_box, route_buffer, time_buffer,
-                                            stop_ids, trip_ids, expanded_stops, expanded_trips);
-                    }
-                }
+            for ( uint32_t row = timetable.trip_offsets[trip]; row < timetable.trip_offsets[trip + 1]; row++ ) {
+                const Stop &stop = timetable.stops[timetable.stop_times.stop[row]];
+                expand_network_from(timetable, stop.lat, stop.lon, iterations,
+                                    start_time_of_day, recursive_time_box, recursive_time_box, route_buffer, time_buffer,
+                                    stop_ids, trip_ids, expanded_stops, expanded_trips, counters);
             }
         }
     }
+
+    if ( counters ) {
+        counters->depth--;
+    }
+    return num_new_trips;
 }
 
 
 
-int optimize_paths(vector<Trip> &trips, unordered_map<string, Stop> &stops,
-                   vector<Stop_Time> &stop_times, vector<Route> &routes,
+int optimize_paths(const Timetable &timetable,
                    double start_lat, double start_lon, double dest_lat, double dest_lon,
-                   string start_time_of_day, double route_buffer, double time_buffer,
-                   int longest_initial_wait, int longest_acceptable_time)
+                   Gtfs_Time start_time_of_day, double route_buffer, double time_buffer,
+                   int longest_initial_wait, int longest_acceptable_time,
+                   /* in/out */ Path_Counters *counters)
 {
     chrono::time_point<chrono::system_clock> start, interm, end;
     chrono::duration<double> process_time;
@@ -389,10 +350,10 @@ int optimize_paths(vector<Trip> &trips, unordered_map<string, Stop> &stops,
     // To make a successful connection, at least one stop in the source network
     // will be in walking distance of a stop in the destination network.
     //
-    set<string> source_stop_ids;   // Unique Stop IDs within source network
-    set<string> source_trip_ids;   // Unique Trip IDs within source network
-    set<string> expanded_source_stops;  // Stops we have already "processed" to expand the network
-    set<string> expanded_source_trips;  // Trips we have already "processed" to expand the network
+    set<Stop_Index> source_stop_ids;   // Unique Stop IDs within source network
+    set<Trip_Index> source_trip_ids;   // Unique Trip IDs within source network
+    set<Stop_Index> expanded_source_stops;  // Stops we have already "processed" to expand the network
+    set<Trip_Index> expanded_source_trips;  // Trips we have already "processed" to expand the network
 
     //
     // From each candidate stop, build a network of trips and stops
@@ -404,24 +365,24 @@ int optimize_paths(vector<Trip> &trips, unordered_map<string, Stop> &stops,
     // multiple intersecting trips.  Some adjustments (or a better
     // method of detection) may be in order.
     //
-    expand_network_from(trips, stops, stop_times, start_lat, start_lon, 2,
+    expand_network_from(timetable, start_lat, start_lon, 2,
                         start_time_of_day, longest_initial_wait, longest_acceptable_time,
                         route_buffer, time_buffer, source_stop_ids, source_trip_ids,
-                        expanded_source_stops, expanded_source_trips);
+                        expanded_source_stops, expanded_source_trips, counters);
 
     interm = end = chrono::system_clock::now();
     process_time = end - start;
     cout << "Source network (" << source_stop_ids.size() << " stops on " << source_trip_ids.size() << " trips) expansion took " << process_time.count() << " seconds." << endl;
 
-    set<string> dest_stop_ids;   // Unique Stop IDs within destination network
-    set<string> dest_trip_ids;   // Unique Trip IDs within destination network
-    set<string> expanded_dest_stops;  // Stops we have already "processed" to expand the network
-    set<string> expanded_dest_trips;  // Trips we have already "processed" to expand the network
+    set<Stop_Index> dest_stop_ids;   // Unique Stop IDs within destination network
+    set<Trip_Index> dest_trip_ids;   // Unique Trip IDs within destination network
+    set<Stop_Index> expanded_dest_stops;  // Stops we have already "processed" to expand the network
+    set<Trip_Index> expanded_dest_trips;  // Trips we have already "processed" to expand the network
 
-    expand_network_from(trips, stops, stop_times, dest_lat, dest_lon, 2,
+    expand_network_from(timetable, dest_lat, dest_lon, 2,
                         start_time_of_day, longest_acceptable_time, longest_acceptable_time,
                         route_buffer, time_buffer, dest_stop_ids, dest_trip_ids,
-                        expanded_dest_stops, expanded_dest_trips);
+                        expanded_dest_stops, expanded_dest_trips, counters);
 
     end = chrono::system_clock::now();
     process_time = end - interm;
@@ -432,7 +393,7 @@ int optimize_paths(vector<Trip> &trips, unordered_map<string, Stop> &stops,
     // networks, then we can construct a reasonable route.  This is
     // currently left as an exercise for the reader (front-end work ;)
     //
-    vector<string> intersecting_stops;
+    vector<Stop_Index> intersecting_stops;
     set_intersection(source_stop_ids.begin(), source_stop_ids.end(),
                      dest_stop_ids.begin(), dest_stop_ids.end(),
                      back_inserter(intersecting_stops));
@@ -440,9 +401,9 @@ int optimize_paths(vector<Trip> &trips, unordered_map<string, Stop> &stops,
     int crux_points = intersecting_stops.size();
     if ( crux_points > 0 ) {
         cout << "Located " << crux_points << " transfer points from source to destination network:" << endl;
-        for ( const string stop_id: intersecting_stops ) {
-            const auto stop = stops[stop_id];
-            cout << "  Stop " << stop.name << " (id " << stop_id << ")." << endl;
+        for ( Stop_Index stop_index: intersecting_stops ) {
+            const Stop &stop = timetable.stops[stop_index];
+            cout << "  Stop " << stop.name << " (id " << stop.id << ")." << endl;
         }
     }
 
@@ -1,3 +1,5 @@
+#pragma once
+
 #include <vector>
 #include <set>
 #include <exception>
@@ -7,28 +9,42 @@
 
 using namespace std;
 
-struct invalid_time_stamp : public exception {
-   const char * what () const throw () {
-      return "Unable to recognize arrival or departure time.";
-   }
-};
+//
+// Optional instrumentation for the hub expansion.  Pass one in to have
+// the counters filled in; set quiet to drop the running commentary
+// (a line per stop time, stop and expansion), which on a big feed
+// costs more than the search itself.
+//
+typedef struct _path_counters
+{
+    bool quiet;
+    long stop_times_scanned;   // Departure rows visited by add_trips_containing_stop
+    long untimed_stop_times;   // ...and rows skipped for want of a departure time
+    long radius_queries;       // Calls to add_stops_within_distance
+    long stops_found;          // Stops those calls returned, new or not
+    long expansions;           // Calls to expand_network_from
+    int depth;                 // Current expand_network_from recursion depth
+    int max_depth;
+    size_t max_stop_set;       // Largest stop and trip sets seen while expanding
+    size_t max_trip_set;
+} Path_Counters;
 
 extern double dist_feet(double th1, double ph1, double th2, double ph2);
 
-extern long difftime_in_minutes(string a, string b); // Throws invalid_time_stamp
-
-extern int add_stops_within_distance(unordered_map<string,Stop> &stops, double lat, double lon, double distance,
-                                     /* in/out */ set<string> &stops_within_distance);
+extern int add_stops_within_distance(const Timetable &timetable, double lat, double lon, double distance,
+                                     /* in/out */ set<Stop_Index> &stops_within_distance,
+                                     /* in/out */ Path_Counters *counters = nullptr);
 
-extern int add_trips_containing_stop(const vector<Trip> &trips, const vector<Stop_Time> &stop_times,
-                                     const Stop &stop, const string *after_time_of_day,
-                                     /* in/out */ set<string> &trips_containing_stop);
+extern int add_trips_containing_stop(const Timetable &timetable, Stop_Index stop,
+                                     Gtfs_Time after_time_of_day, long time_box,  // NO_TIME for any time of day
+                                     /* in/out */ set<Trip_Index> &trips_containing_stop,
+                                     /* in/out */ Path_Counters *counters = nullptr);
 
-extern int optimize_paths(vector<Trip> &trips, unordered_map<string, Stop> &stops,
-                          vector<Stop_Time> &stop_times, vector<Route> &routes,
+extern int optimize_paths(const Timetable &timetable,
                           double start_lat, double start_lon, double dest_lat, double dest_lon,
-                          string start_time_of_day, double route_buffer, double time_buffer,
-                          int longest_intitial_wait, int longest_acceptable_time);
+                          Gtfs_Time start_time_of_day, double route_buffer, double time_buffer,
+                          int longest_intitial_wait, int longest_acceptable_time,
+                          /* in/out */ Path_Counters *counters = nullptr);
 
 
 
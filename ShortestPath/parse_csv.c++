@@ -12,8 +12,15 @@
 
 #include <iostream>
 #include <fstream>
+#include <algorithm>
 #include <errno.h>
 #include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 #include "parse_csv.h"
 using namespace std;
 
@@ -24,124 +31,270 @@ enum quote_modes
     ended
 };
 
-vector<string> parse_quoted_csv_line(string input_line)
+//
+// Most GTFS fields carry no quotes at all, so the common case is just
+// a view of the characters between two commas (less any leading
+// spaces).  Only when a quote turns up do we fall back to rebuilding
+// the field, character by character, in the scratch buffer.
+//
+void split_quoted_csv_line(string_view input_line, vector<string_view> &fields, string &scratch)
 {
-    vector<string> result;
-    string underConstruction;
-    enum quote_modes quote_mode { unstarted };
-    for ( auto ch : input_line ) {
-        switch ( ch ) {
-                
-        case '"':
-            //
-            // Begin and end quotes are consumed without
-            // being processed.
-            // 
-            if ( quote_mode == unstarted ) {
-                quote_mode = started;
-            }
-            else if ( quote_mode == started ) {
-                quote_mode = ended;
-            }
-            //
-            // In the case of a repeated double quote, insert one literal quote 
-            else if ( quote_mode == ended ) {
-                underConstruction.push_back(ch);
-                quote_mode = started;
+    fields.clear();
+    scratch.clear();
+    //
+    // An unquoted field can never be longer than the line it came
+    // from, so reserving that much up front guarantees the views into
+    // scratch stay put while the rest of the line is parsed.
+    //
+    scratch.reserve(input_line.size());
+
+    const char *ch = input_line.data();
+    const char *line_end = ch + input_line.size();
+    for ( ;; ) {
+        //
+        // Ignore leading spaces in fields, found in Australian data
+        //
+        while ( ch < line_end && *ch == ' ' ) {
+            ch++;
+        }
+
+        const char *field_start = ch;
+        while ( ch < line_end && *ch != ',' && *ch != '"' ) {
+            ch++;
+        }
+
+        if ( ch == line_end || *ch == ',' ) {
+            fields.emplace_back(field_start, ch - field_start);
+        }
+        else {
+            size_t constructed_start = scratch.size();
+            scratch.append(field_start, ch - field_start);
+            enum quote_modes quote_mode { unstarted };
+            for ( ; ch < line_end; ch++ ) {
+                if ( *ch == '"' ) {
+                    //
+                    // Begin and end quotes are consumed without
+                    // being processed.
+                    //
+                    if ( quote_mode == unstarted ) {
+                        quote_mode = started;
+                    }
+                    else if ( quote_mode == started ) {
+                        quote_mode = ended;
+                    }
+                    //
+                    // In the case of a repeated double quote, insert one literal quote
+                    else {
+                        scratch.push_back(*ch);
+                        quote_mode = started;
+                    }
+                }
+                else if ( *ch == ',' && quote_mode != started ) {
+                    break;
+                }
+                else if ( *ch == ' ' && quote_mode == unstarted && scratch.size() == constructed_start ) {
+                    continue;
+                }
+                else {
+                    scratch.push_back(*ch);
+                }
             }
-            break;
 
-        case ',':
             //
-            // Add comma to the string if we are within double-quotes
+            // Handle erroneous input line with unterminated quotes
+            // More than likely, we have encountered a new dialect of CSV
             //
             if ( quote_mode == started ) {
-                underConstruction.push_back(ch);
-            }
-            //
-            // Otherwise, terminate the current string and start the next
-            //
-            else {
-                result.push_back(underConstruction);
-                underConstruction.clear();
-                quote_mode = unstarted;
+                throw unterminated_quote_exception();
             }
-            break;
+            fields.emplace_back(scratch.data() + constructed_start, scratch.size() - constructed_start);
+        }
 
-        case ' ':
-            //
-            // Ignore leading spaces in fields, found in Australian data
-            //
-            if ( quote_mode != unstarted || underConstruction.length() > 0 ) {
-                underConstruction.push_back(ch);
-            }
-            break;
-            
-        default:
-            //
-            // Pass regular characters on to the target string
-            //
-            underConstruction.push_back(ch);
+        //
+        // The last (possibly-empty) field ends the line
+        //
+        if ( ch == line_end ) {
             break;
         }
+        ch++;  // Skip over ','
+    }
+}
+
+vector<string> parse_quoted_csv_line(string input_line)
+{
+    vector<string_view> fields;
+    string scratch;
+    split_quoted_csv_line(input_line, fields, scratch);
+    return vector<string>(fields.begin(), fields.end());
+}
+
+
+Mapped_File::Mapped_File(const string &path)
+    : data(""), length(0), mapped(false)
+{
+#ifdef _WIN32
+    ifstream input(path, ios::binary);
+    if ( !input.is_open() ) {
+        cerr << "Error opening file <" << path << ">: " << strerror(errno) << endl;
+        throw missing_file_exception();
+    }
+    buffer.assign(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+    data = buffer.data();
+    length = buffer.size();
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat file_status;
+    if ( fd < 0 || fstat(fd, &file_status) != 0 ) {
+        cerr << "Error opening file <" << path << ">: " << strerror(errno) << endl;
+        if ( fd >= 0 ) {
+            close(fd);
+        }
+        throw missing_file_exception();
     }
-    
+
     //
-    // Handle erroneous input line with unterminated quotes
-    // More than likely, we have encountered a new dialect of CSV
+    // mmap() refuses zero-length mappings, and an empty file needs no
+    // mapping anyway
     //
-    if ( quote_mode == started ) {
-        throw unterminated_quote_exception();
+    if ( file_status.st_size > 0 ) {
+        void *address = mmap(nullptr, file_status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if ( address == MAP_FAILED ) {
+            cerr << "Error mapping file <" << path << ">: " << strerror(errno) << endl;
+            close(fd);
+            throw missing_file_exception();
+        }
+        madvise(address, file_status.st_size, MADV_SEQUENTIAL);
+        data = static_cast<const char *>(address);
+        length = file_status.st_size;
+        mapped = true;
+    }
+    close(fd);
+#endif
+}
+
+Mapped_File::~Mapped_File()
+{
+#ifndef _WIN32
+    if ( mapped ) {
+        munmap(const_cast<char *>(data), length);
+    }
+#endif
+}
+
+
+bool Csv_Reader::next(Csv_Row &row)
+{
+    if ( cursor >= limit ) {
+        return false;
+    }
+
+    const char *line_end = static_cast<const char *>(memchr(cursor, '\n', limit - cursor));
+    if ( line_end == nullptr ) {
+        line_end = limit;
     }
-    
+
     //
-    // Handle the last (possibly-empty) field, still under construction
+    // Lines from DOS-flavored feeds end in "\r\n".  getline() used to
+    // leave the '\r' glued to the last field, which then failed to
+    // match in the header and in the data.
     //
-    result.push_back(underConstruction);
-    return result;
+    const char *text_end = line_end;
+    if ( text_end > cursor && text_end[-1] == '\r' ) {
+        text_end--;
+    }
+
+    row.line = string_view(cursor, text_end - cursor);
+    row.linenum = ++linenum;
+    cursor = line_end + 1;
+    split_quoted_csv_line(row.line, row.fields, row.scratch);
+    return true;
 }
 
+
 //
-// Goal 1: Use Maps to make it easy to see how fields in the CSV are exploited
-//
-// Goal 2 (time permitting): define a custom iterator that loops through CSV lines,
-//   thus localizing more of the line-by-line nature of the data
+// Only the header line is parsed up front.  The rest of the file is
+// streamed through for_each_row(), so no table of records is ever built.
 //
-const bool parse_quoted_csv_file(string folder, string filename, vector<unordered_map<string, string>> &result)
+Csv_File::Csv_File(string folder, string filename)
+    : fullpathfilename(folder.append("/").append(filename)),
+      file(fullpathfilename),
+      body(file.begin())
 {
-    string fullpathfilename(folder);
-    fullpathfilename.append("/").append(filename);
-    ifstream csv_file(fullpathfilename);
-    int linenum = 0;
-    string line;
-    if ( !csv_file.is_open() ) {
-        cerr << "Error opening file <" << fullpathfilename << ">: " << strerror(errno) << endl;
-        throw missing_file_exception();
-    }
-
+    Csv_Reader reader(file.begin(), file.end());
+    Csv_Row header;
     try {
-        //
-        // Read CSV header line
-        //
-        if ( getline(csv_file, line) ) {
-            linenum++;
-            auto field_names = parse_quoted_csv_line(line);
-            while ( getline(csv_file, line) ) {
-                linenum++;
-                unordered_map<string, string> record;
-                auto split_line = parse_quoted_csv_line(line);
-                auto field_name = field_names.begin();
-                for ( auto item : split_line ) {
-                    record[*field_name++] = item;
-                }
-                result.push_back(record);
+        if ( reader.next(header) ) {
+            for ( size_t column = 0; column < header.size(); column++ ) {
+                field_names.emplace_back(header[column]);
             }
+            body = header.text().data() + header.text().size();
+            body = min(file.end(), body + (body < file.end() && *body == '\r' ? 2 : 1));
         }
     }
     catch ( const unterminated_quote_exception &uqe ) {
-        cerr << "Error in file <" << fullpathfilename << ">, line " << linenum << ", unterminated quote: " << line << endl;
-        throw uqe;
+        cerr << "Error in file <" << fullpathfilename << ">, line 1, unterminated quote: " << header.text() << endl;
+        throw;
     }
+}
+
+int Csv_File::column(const string &name) const
+{
+    auto field_name = find(field_names.begin(), field_names.end(), name);
+    return field_name == field_names.end() ? -1 : field_name - field_names.begin();
+}
+
+//
+// Good enough to size containers before loading; a stray blank line
+// (or a missing final newline) only makes this off by one.
+//
+size_t Csv_File::estimated_rows() const
+{
+    return count(body, file.end(), '\n');
+}
+
+vector<const char *> Csv_File::split_body(size_t max_slices, size_t min_slice_bytes) const
+{
+    const char *end = file.end();
+    size_t slices = max<size_t>(1, min(max_slices, (end - body) / max<size_t>(1, min_slice_bytes)));
+    size_t slice_bytes = (end - body) / slices + 1;
+
+    vector<const char *> bounds { body };
+    while ( bounds.back() < end && bounds.size() < slices ) {
+        const char *cut = bounds.back() + min<size_t>(slice_bytes, end - bounds.back());
+        const char *line_end = cut < end ? static_cast<const char *>(memchr(cut, '\n', end - cut)) : nullptr;
+        if ( line_end == nullptr ) {
+            break;
+        }
+        bounds.push_back(line_end + 1);
+    }
+    if ( bounds.back() < end || bounds.size() == 1 ) {
+        bounds.push_back(end);
+    }
+    return bounds;
+}
+
+
+//
+// Goal 1: Use Maps to make it easy to see how fields in the CSV are exploited
+//
+// Goal 2 (time permitting): define a custom iterator that loops through CSV lines,
+//   thus localizing more of the line-by-line nature of the data
+//
+// Goal 2 is now Csv_File::for_each_row(), which load_gtfs_system_data
+// uses instead; this remains for callers that really want the maps.
+//
+const bool parse_quoted_csv_file(string folder, string filename, vector<unordered_map<string, string>> &result)
+{
+    Csv_File csv_file(folder, filename);
+    const auto &field_names = csv_file.columns();
+    csv_file.for_each_row([&result, &field_names](const Csv_Row &row) {
+            unordered_map<string, string> record;
+            size_t num_fields = min(row.size(), field_names.size());
+            for ( size_t column = 0; column < num_fields; column++ ) {
+                record[field_names[column]] = string(row[column]);
+            }
+            result.push_back(move(record));
+        });
 
     return true;
 }
@@ -1,5 +1,9 @@
+#pragma once
+
 #include <string>
+#include <string_view>
 #include <exception>
+#include <iostream>
 #include <vector>
 #include <unordered_map>
 
@@ -19,3 +23,137 @@ extern std::vector<std::string> parse_quoted_csv_line(std::string input_line);
 
 extern const bool parse_quoted_csv_file(std::string folder, std::string filename,
     std::vector<std::unordered_map<std::string, std::string>> &result); // Throws unterminated_quote_exception and missing_file_exception
+
+//
+// Same rules as parse_quoted_csv_line, but the fields are views.  Fields
+// without quotes point straight into input_line; fields that need
+// unquoting are rebuilt in scratch, which must outlive the views.
+//
+extern void split_quoted_csv_line(std::string_view input_line,
+                                  /* out */ std::vector<std::string_view> &fields,
+                                  /* out */ std::string &scratch);  // Throws unterminated_quote_exception
+
+//
+// Read-only image of a whole file: memory-mapped where the platform
+// allows it, otherwise read into one buffer in a single gulp.
+//
+class Mapped_File
+{
+public:
+    Mapped_File(const std::string &path);  // Throws missing_file_exception
+    ~Mapped_File();
+    Mapped_File(const Mapped_File &) = delete;
+    Mapped_File &operator=(const Mapped_File &) = delete;
+
+    const char *begin() const { return data; }
+    const char *end() const { return data + length; }
+    size_t size() const { return length; }
+
+private:
+    const char *data;
+    size_t length;
+    bool mapped;
+    std::string buffer;
+};
+
+//
+// One CSV record.  The fields are views into the file (or into the
+// row's own scratch space), so they are only good until the next call
+// to Csv_Reader::next() with the same row.
+//
+class Csv_Row
+{
+public:
+    size_t size() const { return fields.size(); }
+    bool has(int column) const { return column >= 0 && (size_t) column < fields.size(); }
+    std::string_view operator[](int column) const { return has(column) ? fields[column] : std::string_view(); }
+    std::string_view text() const { return line; }
+    long line_number() const { return linenum; }
+
+private:
+    friend class Csv_Reader;
+    std::vector<std::string_view> fields;
+    std::string scratch;
+    std::string_view line;
+    long linenum { 0 };
+};
+
+//
+// Walks the newline-terminated records between two pointers.  Kept
+// apart from the file itself so that different slices of the same
+// file can be handed to different readers.
+//
+class Csv_Reader
+{
+public:
+    Csv_Reader(const char *begin, const char *end, long first_line_number = 1)
+        : cursor(begin), limit(end), linenum(first_line_number - 1) {}
+
+    bool next(Csv_Row &row);  // Throws unterminated_quote_exception
+
+private:
+    const char *cursor;
+    const char *limit;
+    long linenum;
+};
+
+//
+// A mapped CSV file with its header already parsed, so each field is
+// located by column index rather than by hashing its name on every row.
+//
+class Csv_File
+{
+public:
+    Csv_File(std::string folder, std::string filename);  // Throws missing_file_exception, unterminated_quote_exception
+
+    int column(const std::string &name) const;  // -1 when the header lacks the column
+    const std::vector<std::string> &columns() const { return field_names; }
+    const std::string &path() const { return fullpathfilename; }
+
+    const char *body_begin() const { return body; }
+    const char *body_end() const { return file.end(); }
+    size_t estimated_rows() const;
+
+    //
+    // Hand every record after the header to visit(const Csv_Row &),
+    // reporting the offending line if the CSV turns out to be malformed.
+    //
+    template <typename Visitor>
+    void for_each_row(Visitor visit) const  // Throws unterminated_quote_exception
+    {
+        for_each_row(body, file.end(), 2, visit);
+    }
+
+    //
+    // Split the body into at most max_slices runs of whole lines, for
+    // parsing on separate threads.  Slice i is [bounds[i], bounds[i+1]).
+    //
+    std::vector<const char *> split_body(size_t max_slices, size_t min_slice_bytes) const;
+
+    //
+    // Same as above, for just the records of one slice; first_line_number
+    // is the line of the file that the slice starts on.
+    //
+    template <typename Visitor>
+    void for_each_row(const char *begin, const char *end, long first_line_number, Visitor visit) const
+    {
+        Csv_Reader reader(begin, end, first_line_number);
+        Csv_Row row;
+        try {
+            while ( reader.next(row) ) {
+                visit(row);
+            }
+        }
+        catch ( const unterminated_quote_exception &uqe ) {
+            std::cerr << "Error in file <" << fullpathfilename << ">, line " << row.line_number()
+                      << ", unterminated quote: " << row.text() << std::endl;
+            throw;
+        }
+    }
+
+private:
+    std::string fullpathfilename;
+    Mapped_File file;
+    std::vector<std::string> field_names;
+    const char *body;
+};
@@ -14,141 +14,534 @@
 #include <fstream>
 #include <exception>
 #include <map>
+#include <algorithm>
 #include <unordered_map>
 #include <chrono>
+#include <thread>
+#include <future>
+#include <charconv>
+#include <string_view>
 #include <stdlib.h>
+#include <limits.h>
+#include <stdio.h>
+#include <math.h>
 // #include <filesystem>   File System is still experimental, at least in G++ 4.7.2
 #include "parse_gtfs.h"
 #include "parse_csv.h"
+#include "stop_grid.h"
 using namespace std;
 
 
-string find_required(unordered_map<string, string> &record, string key)
+//
+// Rows arrive as views into the mapped file, so these hand back views
+// too.  Only the values we keep get copied into the PODs.
+//
+string_view find_required(const Csv_File &csv_file, const Csv_Row &row, int column, const char *key)
 {
-    auto pair = record.find(key);
-    if ( pair != record.end() ) {
-        return pair->second;
+    if ( row.has(column) ) {
+        return row[column];
     }
-    
-    cerr << "Unable to find required key " << key << " among the following values: " << endl;
-    for ( auto mypair: record ) {
-        cerr << "   " << mypair.first << ": " << mypair.second << endl;
+
+    if ( column < 0 ) {
+        cerr << "Unable to find required key " << key << " among the columns of <" << csv_file.path() << ">: " << endl;
+        for ( const auto &field_name: csv_file.columns() ) {
+            cerr << "   " << field_name << endl;
+        }
+    }
+    else {
+        cerr << "Unable to find required key " << key << " in <" << csv_file.path() << ">, line "
+             << row.line_number() << ": " << row.text() << endl;
     }
     throw missing_value_exception();
 }
 
-#define find_with_default(hmap, key, defvalue) ( hmap.find(key) != hmap.end() ? hmap[key] : defvalue )
+string_view find_with_default(const Csv_Row &row, int column, string_view defvalue)
+{
+    return row.has(column) ? row[column] : defvalue;
+}
+
+double field_to_double(string_view field)
+{
+    return strtod(string(field).c_str(), nullptr);
+}
+
+long field_to_long(string_view field)
+{
+    long value = 0;
+    from_chars(field.data(), field.data() + field.size(), value);
+    return value;
+}
+
+//
+// Look up an id, adding a placeholder record the first time an unknown
+// one turns up (e.g. a stop_times row naming a stop that stops.txt
+// forgot to define).
+//
+Stop_Index intern_stop(Timetable &timetable, string_view id)
+{
+    auto stop_key_value = timetable.stop_index.find(string(id));
+    if ( stop_key_value != timetable.stop_index.end() ) {
+        return stop_key_value->second;
+    }
+
+    cerr << "UNEXPECTED REFERENCE to non-existent stop " << id << ". Cannot resolve this part of network further." << endl;
+    Stop stop { string(id), "Unspecified", "Unspecified", NAN, NAN };
+    Stop_Index stop_index = timetable.stops.size();
+    timetable.stop_index[stop.id] = stop_index;
+    timetable.stops.push_back(move(stop));
+    return stop_index;
+}
+
+Trip_Index intern_trip(Timetable &timetable, string_view id)
+{
+    auto trip_key_value = timetable.trip_index.find(string(id));
+    if ( trip_key_value != timetable.trip_index.end() ) {
+        return trip_key_value->second;
+    }
+
+    Trip trip { NO_INDEX, string(id), "Unspecified" };
+    Trip_Index trip_index = timetable.trips.size();
+    timetable.trip_index[trip.id] = trip_index;
+    timetable.trips.push_back(move(trip));
+    return trip_index;
+}
+
+//
+// Converted once at load, so nothing downstream ever has to call
+// strptime()/mktime() (and their time zone lookups) in a search loop.
+//
+Gtfs_Time parse_gtfs_time(string_view stamp)
+{
+    int hours = 0, minutes = 0, seconds = 0;
+    const char *end = stamp.data() + stamp.size();
+    auto parsed = from_chars(stamp.data(), end, hours);
+    if ( parsed.ec != errc() || parsed.ptr == end || *parsed.ptr != ':' || hours < 0 || hours > 999 ) {
+        return NO_TIME;
+    }
+
+    parsed = from_chars(parsed.ptr + 1, end, minutes);
+    if ( parsed.ec != errc() || minutes < 0 || minutes > 59 ) {
+        return NO_TIME;
+    }
+
+    if ( parsed.ptr != end && *parsed.ptr == ':' ) {
+        parsed = from_chars(parsed.ptr + 1, end, seconds);
+        if ( parsed.ec != errc() || seconds < 0 || seconds > 59 ) {
+            return NO_TIME;
+        }
+    }
+
+    //
+    // Tolerate trailing blanks, but nothing else
+    //
+    const char *remainder = parsed.ptr;
+    while ( remainder != end && *remainder == ' ' ) {
+        remainder++;
+    }
+    if ( remainder != end ) {
+        return NO_TIME;
+    }
+
+    return (hours * 60 + minutes) * 60 + seconds;
+}
+
+//
+// A single time is a window that opens and closes at once
+//
+bool parse_gtfs_time_window(string_view window, Gtfs_Time &earliest, Gtfs_Time &latest)
+{
+    size_t dash = window.find('-');
+    earliest = parse_gtfs_time(window.substr(0, dash));
+    latest = dash == string_view::npos ? earliest : parse_gtfs_time(window.substr(dash + 1));
+    return earliest != NO_TIME && latest != NO_TIME && earliest <= latest;
+}
+
+string format_gtfs_time(Gtfs_Time time)
+{
+    if ( time == NO_TIME ) {
+        return "--:--:--";
+    }
+
+    char stamp[16];
+    snprintf(stamp, sizeof(stamp), "%02d:%02d:%02d", time / 3600, time / 60 % 60, time % 60);
+    return stamp;
+}
+
+//
+// Put stop_times in (trip, sequence) order and build the CSR indexes
+// described in parse_gtfs.h.  Most feeds already list stop times trip
+// by trip, in which case the reordering is skipped entirely.
+//
+void index_stop_times(Timetable &timetable)
+{
+    Stop_Times &stop_times = timetable.stop_times;
+    size_t num_rows = stop_times.size();
+
+    auto row_order = [&stop_times](uint32_t a, uint32_t b) {
+        return stop_times.trip[a] != stop_times.trip[b] ? stop_times.trip[a] < stop_times.trip[b]
+                                                         : stop_times.sequence[a] < stop_times.sequence[b];
+    };
+
+    vector<uint32_t> rows(num_rows);
+    for ( uint32_t row = 0; row < num_rows; row++ ) {
+        rows[row] = row;
+    }
+    if ( !is_sorted(rows.begin(), rows.end(), row_order) ) {
+        stable_sort(rows.begin(), rows.end(), row_order);
+        Stop_Times sorted;
+        sorted.trip.reserve(num_rows);
+        sorted.stop.reserve(num_rows);
+        sorted.arrive.reserve(num_rows);
+        sorted.depart.reserve(num_rows);
+        sorted.sequence.reserve(num_rows);
+        for ( auto row: rows ) {
+            sorted.trip.push_back(stop_times.trip[row]);
+            sorted.stop.push_back(stop_times.stop[row]);
+            sorted.arrive.push_back(stop_times.arrive[row]);
+            sorted.depart.push_back(stop_times.depart[row]);
+            sorted.sequence.push_back(stop_times.sequence[row]);
+        }
+        stop_times = move(sorted);
+    }
+
+    //
+    // Rows of each trip: count, then prefix-sum into offsets
+    //
+    auto &trip_offsets = timetable.trip_offsets.owned();
+    trip_offsets.assign(timetable.trips.size() + 1, 0);
+    for ( auto trip: stop_times.trip ) {
+        trip_offsets[trip + 1]++;
+    }
+    for ( size_t trip = 0; trip < timetable.trips.size(); trip++ ) {
+        trip_offsets[trip + 1] += trip_offsets[trip];
+    }
+
+    //
+    // Departures at each stop: counting sort by stop, then order each
+    // stop's slice by departure time
+    //
+    auto &stop_offsets = timetable.stop_offsets.owned();
+    stop_offsets.assign(timetable.stops.size() + 1, 0);
+    for ( auto stop: stop_times.stop ) {
+        stop_offsets[stop + 1]++;
+    }
+    for ( size_t stop = 0; stop < timetable.stops.size(); stop++ ) {
+        stop_offsets[stop + 1] += stop_offsets[stop];
+    }
+
+    vector<uint32_t> next_slot(stop_offsets.begin(), stop_offsets.end() - 1);
+    auto &stop_departures = timetable.stop_departures.owned();
+    stop_departures.resize(num_rows);
+    for ( uint32_t row = 0; row < num_rows; row++ ) {
+        stop_departures[next_slot[stop_times.stop[row]]++] = row;
+    }
+    const auto &depart = stop_times.depart;
+    for ( size_t stop = 0; stop < timetable.stops.size(); stop++ ) {
+        stable_sort(stop_departures.begin() + stop_offsets[stop],
+                    stop_departures.begin() + stop_offsets[stop + 1],
+                    [&depart](uint32_t a, uint32_t b) { return depart[a] < depart[b]; });
+    }
+}
     
 
-bool load_gtfs_system_data(string gtfs_data_folder,
-                           vector<Agency> &agencies,
-                           vector<Route> &routes,
-                           unordered_map<string, Stop> &stops,
-                           vector<Stop_Time> &stop_times,
-                           vector<Trip> &trips)
+//
+// stop_times rows from one slice of stop_times.txt.  Trip and stop ids
+// are numbered in order of first appearance within the slice, and only
+// resolved against the Timetable once trips.txt and stops.txt are in,
+// so slices can be parsed while those files are still being read.
+//
+typedef struct _stop_time_slice
+{
+    const char *begin;
+    const char *end;
+    long first_line_number;
+    size_t rows;
+    std::vector<std::string> trip_ids;
+    std::vector<std::string> stop_ids;
+    std::vector<int32_t> trip;   // Positions in trip_ids
+    std::vector<int32_t> stop;   // Positions in stop_ids
+    std::vector<Gtfs_Time> arrive;
+    std::vector<Gtfs_Time> depart;
+    std::vector<int32_t> sequence;
+} Stop_Time_Slice;
+
+static void parse_stop_time_slice(const Csv_File &stop_time_file, Stop_Time_Slice &slice)
+{
+    int stop_time_trip = stop_time_file.column("trip_id");
+    int stop_time_arrive = stop_time_file.column("arrival_time");
+    int stop_time_depart = stop_time_file.column("departure_time");
+    int stop_time_stop = stop_time_file.column("stop_id");
+    int stop_time_sequence = stop_time_file.column("stop_sequence");
+
+    slice.trip.reserve(slice.rows);
+    slice.stop.reserve(slice.rows);
+    slice.arrive.reserve(slice.rows);
+    slice.depart.reserve(slice.rows);
+    slice.sequence.reserve(slice.rows);
+
+    //
+    // Rows for one trip normally arrive together, so remembering the
+    // last trip id skips most of the hash lookups
+    //
+    unordered_map<string, int32_t> trip_numbers, stop_numbers;
+    int32_t last_trip = -1;
+    stop_time_file.for_each_row(slice.begin, slice.end, slice.first_line_number, [&](const Csv_Row &row) {
+            string_view trip_id = find_required(stop_time_file, row, stop_time_trip, "trip_id");
+            if ( last_trip < 0 || trip_id != slice.trip_ids[last_trip] ) {
+                auto trip_number = trip_numbers.emplace(string(trip_id), slice.trip_ids.size());
+                if ( trip_number.second ) {
+                    slice.trip_ids.emplace_back(trip_id);
+                }
+                last_trip = trip_number.first->second;
+            }
+            string_view stop_id = find_required(stop_time_file, row, stop_time_stop, "stop_id");
+            auto stop_number = stop_numbers.emplace(string(stop_id), slice.stop_ids.size());
+            if ( stop_number.second ) {
+                slice.stop_ids.emplace_back(stop_id);
+            }
+
+            slice.trip.push_back(last_trip);
+            slice.stop.push_back(stop_number.first->second);
+            slice.arrive.push_back(parse_gtfs_time(find_with_default(row, stop_time_arrive, "")));
+            slice.depart.push_back(parse_gtfs_time(find_with_default(row, stop_time_depart, "")));
+            slice.sequence.push_back(field_to_long(find_with_default(row, stop_time_sequence, "0")));
+        });
+}
+
+//
+// Append the slices to timetable.stop_times in file order, resolving
+// their ids (and adding placeholders for unknown ones) in the same
+// order the rows appear in the file
+//
+static void merge_stop_time_slices(vector<Stop_Time_Slice> &slices, Timetable &timetable)
+{
+    Stop_Times &stop_times = timetable.stop_times;
+    size_t num_rows = 0;
+    for ( const auto &slice: slices ) {
+        num_rows += slice.trip.size();
+    }
+    stop_times.trip.reserve(num_rows);
+    stop_times.stop.reserve(num_rows);
+    stop_times.arrive.reserve(num_rows);
+    stop_times.depart.reserve(num_rows);
+    stop_times.sequence.reserve(num_rows);
+
+    vector<Trip_Index> trip_indexes;
+    vector<Stop_Index> stop_indexes;
+    for ( auto &slice: slices ) {
+        trip_indexes.clear();
+        for ( const auto &trip_id: slice.trip_ids ) {
+            trip_indexes.push_back(intern_trip(timetable, trip_id));
+        }
+        stop_indexes.clear();
+        for ( const auto &stop_id: slice.stop_ids ) {
+            stop_indexes.push_back(intern_stop(timetable, stop_id));
+        }
+
+        for ( size_t row = 0; row < slice.trip.size(); row++ ) {
+            stop_times.trip.push_back(trip_indexes[slice.trip[row]]);
+            stop_times.stop.push_back(stop_indexes[slice.stop[row]]);
+            stop_times.arrive.push_back(slice.arrive[row]);
+            stop_times.depart.push_back(slice.depart[row]);
+            stop_times.sequence.push_back(slice.sequence[row]);
+        }
+        slice = Stop_Time_Slice();
+    }
+}
+
+static double seconds_since(chrono::time_point<chrono::system_clock> start)
+{
+    chrono::duration<double> process_time = chrono::system_clock::now() - start;
+    return process_time.count();
+}
+
+bool load_gtfs_system_data(string gtfs_data_folder, Timetable &timetable, size_t max_stop_time_slices, size_t min_stop_time_slice_bytes)
 {
-    bool rc;
+    bool rc = true;
     chrono::time_point<chrono::system_clock> start, end;
     chrono::duration<double> process_time;
+    double agency_seconds = 0, route_seconds = 0, stop_seconds = 0, trip_seconds = 0, stop_time_seconds = 0;
+    start = chrono::system_clock::now();
 
     //
-    // If there were more generic work to be done here, these next 5
-    // stanzas would be a good case for object-ification.
-    // Unfortunately, the minimum overhead for defining a class would
-    // overwhelm the likely savings.
+    // The files don't depend on each other until stop_times has to be
+    // resolved, so they are all read at once: agency, stops, and
+    // routes-then-trips (trips name their route) on a thread each, and
+    // stop_times in slices on as many threads as there are cores.
+    // Each stanza writes only its own parts of the Timetable.
+    //
+    // Everything the threads use is declared before the futures, whose
+    // destructors wait for the threads, so an exception can't pull
+    // anything out from under a thread that's still running.
+    //
+    Csv_File stop_time_file(gtfs_data_folder, "stop_times.txt");
+    vector<Stop_Time_Slice> slices;
 
     //
     // Read list of agencies (Perth WA has multiple)
     //
-    start = chrono::system_clock::now();
-    vector<unordered_map<string, string>> agency_table;
-    rc = parse_quoted_csv_file(gtfs_data_folder, "agency.txt", agency_table);
-    for ( auto agency_fields : agency_table ) {
-        Agency agency;
-        agency.id = find_required(agency_fields, "agency_id");
-        agency.name = find_with_default(agency_fields, "agency_name", "MISSING");
-        agency.email = find_with_default(agency_fields, "agency_email", "Unspecified");
-        agencies.push_back(agency);
-    }
-    end = chrono::system_clock::now();
-    process_time = end - start;
-    cout << "Read agency data in : " << process_time.count() << " seconds." << endl;
-    start = end;
-    
+    auto agency_loaded = async(launch::async, [&]() {
+            auto agency_start = chrono::system_clock::now();
+            Csv_File agency_file(gtfs_data_folder, "agency.txt");
+            int agency_id = agency_file.column("agency_id");
+            int agency_name = agency_file.column("agency_name");
+            int agency_email = agency_file.column("agency_email");
+            agency_file.for_each_row([&](const Csv_Row &row) {
+                    Agency agency;
+                    agency.id = find_required(agency_file, row, agency_id, "agency_id");
+                    agency.name = find_with_default(row, agency_name, "MISSING");
+                    agency.email = find_with_default(row, agency_email, "Unspecified");
+                    timetable.agencies.push_back(move(agency));
+                });
+            agency_seconds = seconds_since(agency_start);
+        });
 
     //
-    // Read list of routes
+    // Read list of routes, then the trips that run them
     //
-    vector<unordered_map<string, string>> route_table;
-    rc = parse_quoted_csv_file(gtfs_data_folder, "routes.txt", route_table);
-    for ( auto route_fields : route_table ) {
-        Route route;
-        route.id = find_required(route_fields, "route_id");
-        route.short_name = find_with_default(route_fields, "route_short_name", "Unspecified");
-        route.long_name = find_with_default(route_fields, "route_long_name", "Unspecified");
-        route.desc = find_with_default(route_fields, "route_desc", "Unspecified");
-        routes.push_back(route);
-    }
-    end = chrono::system_clock::now();
-    process_time = end - start;
-    cout << "Read route data in :  " << process_time.count() << " seconds." << endl;
-    start = end;
+    auto routes_and_trips_loaded = async(launch::async, [&]() {
+            auto route_start = chrono::system_clock::now();
+            Csv_File route_file(gtfs_data_folder, "routes.txt");
+            int route_id = route_file.column("route_id");
+            int route_short_name = route_file.column("route_short_name");
+            int route_long_name = route_file.column("route_long_name");
+            int route_desc = route_file.column("route_desc");
+            timetable.routes.reserve(route_file.estimated_rows());
+            route_file.for_each_row([&](const Csv_Row &row) {
+                    Route route;
+                    route.id = find_required(route_file, row, route_id, "route_id");
+                    route.short_name = find_with_default(row, route_short_name, "Unspecified");
+                    route.long_name = find_with_default(row, route_long_name, "Unspecified");
+                    route.desc = find_with_default(row, route_desc, "Unspecified");
+                    timetable.route_index[route.id] = timetable.routes.size();
+                    timetable.routes.push_back(move(route));
+                });
+            route_seconds = seconds_since(route_start);
+
+            auto trip_start = chrono::system_clock::now();
+            Csv_File trip_file(gtfs_data_folder, "trips.txt");
+            int trip_route = trip_file.column("route_id");
+            int trip_id = trip_file.column("trip_id");
+            int trip_headsign = trip_file.column("trip_headsign");
+            timetable.trips.reserve(trip_file.estimated_rows());
+            trip_file.for_each_row([&](const Csv_Row &row) {
+                    Trip trip;
+                    auto route_key_value = timetable.route_index.find(string(find_required(trip_file, row, trip_route, "route_id")));
+                    trip.route = route_key_value == timetable.route_index.end() ? NO_INDEX : route_key_value->second;
+                    trip.id = find_required(trip_file, row, trip_id, "trip_id");
+                    trip.headsign = find_with_default(row, trip_headsign, "Unspecified");
+                    timetable.trip_index[trip.id] = timetable.trips.size();
+                    timetable.trips.push_back(move(trip));
+                });
+            trip_seconds = seconds_since(trip_start);
+        });
 
     //
     // Read list of stops
     //
-    vector<unordered_map<string, string>> stop_table;
-    rc = parse_quoted_csv_file(gtfs_data_folder, "stops.txt", stop_table);
-    for ( auto stop_fields : stop_table ) {
-        Stop stop;
-        stop.id = find_required(stop_fields, "stop_id");
-        stop.code = find_with_default(stop_fields, "stop_code", "Unspecified");
-        stop.name = find_with_default(stop_fields, "stop_name", "Unspecified");
-        stop.lat = strtod(find_required(stop_fields, "stop_lat").c_str(), nullptr);
-        stop.lon = strtod(find_required(stop_fields, "stop_lon").c_str(), nullptr);
-        stops[stop.id] = stop;
-    }
-    end = chrono::system_clock::now();
-    process_time = end - start;
-    cout << "Read stop data in :   " << process_time.count() << " seconds." << endl;
-    start = end;
+    auto stops_loaded = async(launch::async, [&]() {
+            auto stop_start = chrono::system_clock::now();
+            Csv_File stop_file(gtfs_data_folder, "stops.txt");
+            int stop_id = stop_file.column("stop_id");
+            int stop_code = stop_file.column("stop_code");
+            int stop_name = stop_file.column("stop_name");
+            int stop_lat = stop_file.column("stop_lat");
+            int stop_lon = stop_file.column("stop_lon");
+            timetable.stops.reserve(stop_file.estimated_rows());
+            stop_file.for_each_row([&](const Csv_Row &row) {
+                    Stop stop;
+                    stop.id = find_required(stop_file, row, stop_id, "stop_id");
+                    stop.code = find_with_default(row, stop_code, "Unspecified");
+                    stop.name = find_with_default(row, stop_name, "Unspecified");
+                    stop.lat = field_to_double(find_required(stop_file, row, stop_lat, "stop_lat"));
+                    stop.lon = field_to_double(find_required(stop_file, row, stop_lon, "stop_lon"));
 
+                    //
+                    // A repeated stop id replaces the earlier definition, as
+                    // it did when stops were kept in a map
+                    //
+                    auto insert_result = timetable.stop_index.emplace(stop.id, timetable.stops.size());
+                    if ( insert_result.second ) {
+                        timetable.stops.push_back(move(stop));
+                    }
+                    else {
+                        timetable.stops[insert_result.first->second] = move(stop);
+                    }
+                });
+            stop_seconds = seconds_since(stop_start);
+        });
 
     //
-    // Read list of stop_times
+    // Read list of stop_times.  This is the big one (millions of rows
+    // on a metro feed).  Every line is one record, so counting the
+    // newlines in each slice (a quick pass, also done in parallel)
+    // tells each slice its first line number, for error messages, and
+    // how many rows to make room for.
     //
-    vector<unordered_map<string, string>> stop_time_table;
-    rc = parse_quoted_csv_file(gtfs_data_folder, "stop_times.txt", stop_time_table);
-    for ( auto stop_time_fields : stop_time_table ) {
-        Stop_Time stop_time;
-        stop_time.trip = find_required(stop_time_fields, "trip_id");
-        stop_time.arrive = find_with_default(stop_time_fields, "arrival_time", "Unspecified");
-        stop_time.depart = find_with_default(stop_time_fields, "departure_time", "Unspecified");
-        stop_time.stop = find_required(stop_time_fields, "stop_id");
-        stop_time.sequence = strtol(find_with_default(stop_time_fields, "stop_sequence", "0").c_str(), nullptr, 10);
-        stop_times.push_back(stop_time);
-    }
+    auto stop_times_loaded = async(launch::async, [&]() {
+            auto stop_time_start = chrono::system_clock::now();
+            if ( max_stop_time_slices == 0 ) {
+                max_stop_time_slices = max(1u, thread::hardware_concurrency());
+            }
+            auto bounds = stop_time_file.split_body(max_stop_time_slices, min_stop_time_slice_bytes);
+            slices.resize(bounds.size() - 1);
+            vector<future<void>> slices_loaded;
+            for ( size_t i = 0; i < slices.size(); i++ ) {
+                slices[i].begin = bounds[i];
+                slices[i].end = bounds[i + 1];
+                slices_loaded.push_back(async(launch::async, [&slice = slices[i]]() {
+                            slice.rows = count(slice.begin, slice.end, '\n') + (slice.end > slice.begin && slice.end[-1] != '\n');
+                        }));
+            }
+            for ( auto &slice_loaded: slices_loaded ) {
+                slice_loaded.get();
+            }
+
+            slices_loaded.clear();
+            long line_number = 2;
+            for ( auto &slice: slices ) {
+                slice.first_line_number = line_number;
+                line_number += slice.rows;
+                slices_loaded.push_back(async(launch::async, [&stop_time_file, &slice]() {
+                            parse_stop_time_slice(stop_time_file, slice);
+                        }));
+            }
+            for ( auto &slice_loaded: slices_loaded ) {
+                slice_loaded.get();
+            }
+            stop_time_seconds = seconds_since(stop_time_start);
+        });
+
+    agency_loaded.get();
+    routes_and_trips_loaded.get();
+    stops_loaded.get();
+    stop_times_loaded.get();
+    end = chrono::system_clock::now();
+    process_time = end - start;
+    cout << "Read agency data in : " << agency_seconds << " seconds." << endl;
+    cout << "Read route data in :  " << route_seconds << " seconds." << endl;
+    cout << "Read stop data in :   " << stop_seconds << " seconds." << endl;
+    cout << "Read trip data in :   " << trip_seconds << " seconds." << endl;
+    cout << "Read stop times in :  " << stop_time_seconds << " seconds (" << slices.size() << " slices)." << endl;
+    cout << "Read all files in :   " << process_time.count() << " seconds." << endl;
+    start = end;
+
+    merge_stop_time_slices(slices, timetable);
     end = chrono::system_clock::now();
     process_time = end - start;
-    cout << "Read stop times in :  " << process_time.count() << " seconds." << endl;
+    cout << "Merged stop times in: " << process_time.count() << " seconds." << endl;
     start = end;
 
+    index_stop_times(timetable);
+    end = chrono::system_clock::now();
+    process_time = end - start;
+    cout << "Indexed stop times:   " << process_time.count() << " seconds." << endl;
+    start = end;
 
-    //
-    // Read list of trips
-    //
-    vector<unordered_map<string, string>> trip_table;
-    rc = parse_quoted_csv_file(gtfs_data_folder, "trips.txt", trip_table);
-    for ( auto trip_fields : trip_table ) {
-        Trip trip;
-        trip.route = find_required(trip_fields, "route_id");
-        trip.id = find_required(trip_fields, "trip_id");
-        trip.headsign = find_with_default(trip_fields, "trip_headsign", "Unspecified");
-        trips.push_back(trip);
-    }
+    build_stop_grid(timetable);
     end = chrono::system_clock::now();
     process_time = end - start;
-    cout << "Read trip data in :   " << process_time.count() << " seconds." << endl;
+    cout << "Indexed stop grid:    " << process_time.count() << " seconds." << endl;
 
     return rc;
 }
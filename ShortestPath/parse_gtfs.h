@@ -6,16 +6,44 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
+#include <cstdint>
+#include <memory>
 #include <unordered_map>
+#include <cassert>
 
-typedef struct _agency 
+class Mapped_File;
+
+//
+// GTFS identifiers are strings, but once loaded every stop, trip and
+// route is known by its position in the Timetable vectors.  The
+// string ids stay in the PODs for display, and in the *_index maps
+// for looking up whatever a user (or a CSV file) hands us.
+//
+typedef int32_t Route_Index;
+typedef int32_t Stop_Index;
+typedef int32_t Trip_Index;
+
+const int32_t NO_INDEX = -1;
+
+//
+// Times of day are kept as seconds since the start of the service day.
+// GTFS lets these run past 24:00:00 (e.g. "25:10:00") for trips that
+// finish after midnight.  Blank or garbled stamps become NO_TIME, which
+// sorts after every real time.
+//
+typedef int32_t Gtfs_Time;
+
+const Gtfs_Time NO_TIME = INT32_MAX;
+
+typedef struct _agency
 {
     std::string id;
     std::string name;
     std::string email;
 } Agency;
 
-typedef struct _route 
+typedef struct _route
 {
     std::string id;
     std::string short_name;
@@ -23,7 +51,7 @@ typedef struct _route
     std::string desc;
 } Route;
 
-typedef struct _stop 
+typedef struct _stop
 {
     std::string id;
     std::string code;
@@ -32,22 +60,125 @@ typedef struct _stop
     double lon;
 } Stop;
 
-typedef struct _stop_time 
+typedef struct _trip
 {
-    std::string trip;
-    std::string arrive;
-    std::string depart;
-    std::string stop;
-    long sequence;
-} Stop_Time;
-
-typedef struct _trip 
-{
-    std::string route;
+    Route_Index route;   // NO_INDEX when routes.txt never mentions it
     std::string id;
     std::string headsign;
 } Trip;
 
+//
+// An array that either owns its elements (built while loading CSV) or
+// borrows them, in place, from a mapped snapshot file (see
+// snapshot.c++).  Reading looks just like std::vector, whichever it
+// is.  Only an owned column may be modified, through owned(), which is
+// for the loader's own indexing code.
+//
+template <typename T>
+class Column
+{
+public:
+    size_t size() const { return borrowed ? borrowed_size : storage.size(); }
+    bool empty() const { return size() == 0; }
+    const T *data() const { return borrowed ? borrowed : storage.data(); }
+    const T *begin() const { return data(); }
+    const T *end() const { return data() + size(); }
+    const T &operator[](size_t i) const { return data()[i]; }
+    const T &back() const { return data()[size() - 1]; }
+
+    std::vector<T> &owned() { assert(!borrowed); return storage; }
+    void push_back(const T &value) { owned().push_back(value); }
+    void reserve(size_t count) { owned().reserve(count); }
+    void resize(size_t count) { owned().resize(count); }
+    void assign(size_t count, const T &value) { owned().assign(count, value); }
+    template <typename Iterator> void assign(Iterator first, Iterator last) { owned().assign(first, last); }
+
+    void borrow(const T *elements, size_t count)
+    {
+        storage = std::vector<T>();
+        borrowed = elements;
+        borrowed_size = count;
+    }
+
+private:
+    std::vector<T> storage;
+    const T *borrowed { nullptr };
+    size_t borrowed_size { 0 };
+};
+
+//
+// Stop times, one vector per column, sorted by (trip, sequence) so
+// that the stop times of a single trip are one contiguous slice.  A
+// "row" is a position in these vectors.
+//
+typedef struct _stop_times
+{
+    Column<Trip_Index> trip;
+    Column<Stop_Index> stop;
+    Column<Gtfs_Time> arrive;
+    Column<Gtfs_Time> depart;
+    Column<int32_t> sequence;
+
+    size_t size() const { return trip.size(); }
+} Stop_Times;
+
+//
+// Uniform latitude/longitude grid over the stops, for radius queries.
+// Cells are numbered row-major from the south-west corner, so the
+// cells of one grid row that a query touches are one contiguous run
+// of the packed arrays.  Those hold each stop's position as a unit
+// vector, which turns distance tests into a few multiply-adds (see
+// stop_grid.c++).
+//
+typedef struct _stop_grid
+{
+    double south;
+    double west;
+    double cell_degrees;
+    int32_t rows;
+    int32_t columns;
+    Column<uint32_t> cell_offsets;   // stops in cell C: [cell_offsets[C], cell_offsets[C+1])
+    Column<Stop_Index> stop;
+    Column<double> x;
+    Column<double> y;
+    Column<double> z;
+} Stop_Grid;
+
+typedef struct _timetable
+{
+    std::vector<Agency> agencies;
+    std::vector<Route> routes;
+    std::vector<Stop> stops;
+    std::vector<Trip> trips;
+
+    std::unordered_map<std::string, Route_Index> route_index;
+    std::unordered_map<std::string, Stop_Index> stop_index;
+    std::unordered_map<std::string, Trip_Index> trip_index;
+
+    Stop_Times stop_times;
+
+    //
+    // Compressed (CSR-style) indexes over stop_times:
+    //
+    //   rows of trip T:          [trip_offsets[T], trip_offsets[T+1])
+    //   departures at stop S:    stop_departures[stop_offsets[S] .. stop_offsets[S+1])
+    //
+    // stop_departures holds row numbers, ordered by departure time
+    // within each stop (rows with NO_TIME sort last), so the departures
+    // inside a time window can be found with a binary search.
+    //
+    Column<uint32_t> trip_offsets;
+    Column<uint32_t> stop_offsets;
+    Column<uint32_t> stop_departures;
+
+    Stop_Grid stop_grid;
+
+    //
+    // Keeps the snapshot file mapped while columns borrow from it
+    //
+    std::shared_ptr<Mapped_File> snapshot;
+} Timetable;
+
 
 struct missing_value_exception : public std::exception {
    const char * what () const throw () {
@@ -55,11 +186,28 @@ struct missing_value_exception : public std::exception {
    }
 };
 
+extern Gtfs_Time parse_gtfs_time(std::string_view stamp);  // "H:MM:SS" or "H:MM"; NO_TIME if unrecognizable
+
+//
+// "hh:mm-hh:mm" (either end may have seconds), or a single time; false
+// if unrecognizable or the window closes before it opens
+//
+extern bool parse_gtfs_time_window(std::string_view window,
+                                   /* out */ Gtfs_Time &earliest,
+                                   /* out */ Gtfs_Time &latest);
+
+extern std::string format_gtfs_time(Gtfs_Time time);
+
+//
+// stop_times.txt is read in up to max_stop_time_slices slices at once
+// (0 for one per core), none smaller than min_stop_time_slice_bytes;
+// below that size, a slice isn't worth starting a thread for.  The
+// Timetable comes out the same however the file is sliced.
+//
+const size_t MIN_STOP_TIME_SLICE_BYTES = 1 << 20;
+
 extern bool load_gtfs_system_data(std::string gtfs_data_folder,
-                                  std::vector<Agency> &agencies,
-                                  std::vector<Route> &routes,
-                                  std::unordered_map<std::string, Stop> &stops,
-                                  std::vector<Stop_Time> &stop_times,
-                                  std::vector<Trip> &trips
+                                  /* out */ Timetable &timetable,
+                                  size_t max_stop_time_slices = 0,
+                                  size_t min_stop_time_slice_bytes = MIN_STOP_TIME_SLICE_BYTES
                                   ); // Throws missing_file_exception, missing_value_exception, and unterminated_quote_exception
-
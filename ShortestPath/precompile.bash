@@ -1,2 +1,2 @@
-g++ -std=c++11 main.c++ -E -o main.i
-g++ -std=c++11 optimize_path.c++ -E -o optimize_path.i
+g++ -std=c++17 main.c++ -E -o main.i
+g++ -std=c++17 optimize_path.c++ -E -o optimize_path.i
@@ -0,0 +1,701 @@
+//
+// RAPTOR earliest-arrival routing
+//
+// Delling, Pajor & Werneck, "Round-Based Public Transit Routing",
+// ALENEX 2012.  In outline:
+//
+//   round 0:  walk from the starting point to every stop within
+//             route_buffer feet.
+//   round k:  for every pattern serving a stop improved in round k-1,
+//             hop on the earliest trip we can still catch and ride it
+//             to the end of the pattern, improving the arrival time at
+//             each later stop; then walk from the stops just improved
+//             to their neighbors (the precomputed footpaths).
+//
+// A journey found in round k uses k vehicles, i.e. k-1 transfers.
+// Each round touches each pattern at most once, so a query costs
+// time linear in the part of the timetable it can actually reach.
+//
+// Profile queries over a departure window run the rounds once per
+// useful departure, latest first, keeping the labels (rRAPTOR, from
+// the same paper); see raptor_sweep.
+//
+// SIMPLIFYING ASSUMPTIONS (shared with the hub expansion)
+//
+//   (1) All published trips happen every day
+//   (2) Stops without a published time can neither be boarded at
+//       nor alighted at (no interpolation of non-timepoints)
+//
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <functional>
+#include <math.h>
+#include "parse_gtfs.h"
+#include "optimize_path.h"
+#include "stop_grid.h"
+#include "raptor.h"
+
+using namespace std;
+
+const Gtfs_Time UNREACHED = NO_TIME;
+
+static Gtfs_Time walking_seconds(double feet)
+{
+    return (Gtfs_Time) ceil(feet / WALKING_FEET_PER_SECOND);
+}
+
+//
+// True when trip b never runs ahead of trip a at any timed stop, so
+// the two can share a pattern without one overtaking the other
+//
+static bool runs_behind(const Timetable &timetable, Trip_Index a, Trip_Index b, size_t length)
+{
+    const Stop_Times &stop_times = timetable.stop_times;
+    uint32_t a_row = timetable.trip_offsets[a], b_row = timetable.trip_offsets[b];
+    for ( size_t i = 0; i < length; i++ ) {
+        if ( stop_times.arrive[b_row + i] < stop_times.arrive[a_row + i] ||
+             stop_times.depart[b_row + i] < stop_times.depart[a_row + i] ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void build_raptor_network(const Timetable &timetable, double route_buffer, double time_buffer,
+                          Raptor_Network &network)
+{
+    const Stop_Times &stop_times = timetable.stop_times;
+    network = Raptor_Network();
+    network.route_buffer = route_buffer;
+    network.transfer_slack = (Gtfs_Time) ceil(time_buffer * 60);
+
+    //
+    // Group trips by layout: the stops they visit, in order, and which
+    // of those have published arrival/departure times.  Within a
+    // layout, either every trip is timed at a position or none is, so
+    // times at a position can be binary searched.
+    //
+    map<vector<int64_t>, vector<Trip_Index>> trips_by_layout;
+    vector<int64_t> layout;
+    for ( Trip_Index trip = 0; trip < (Trip_Index) timetable.trips.size(); trip++ ) {
+        uint32_t first = timetable.trip_offsets[trip], last = timetable.trip_offsets[trip + 1];
+        layout.clear();
+        bool boardable = false;
+        for ( uint32_t row = first; row < last; row++ ) {
+            int64_t timed = (stop_times.arrive[row] != NO_TIME ? 1 : 0) | (stop_times.depart[row] != NO_TIME ? 2 : 0);
+            boardable |= (row + 1 < last && stop_times.depart[row] != NO_TIME);
+            layout.push_back((int64_t) stop_times.stop[row] * 4 + timed);
+        }
+        if ( boardable ) {
+            trips_by_layout[layout].push_back(trip);
+        }
+    }
+
+    //
+    // Order each layout's trips by their first published departure,
+    // then deal them out into patterns, starting a new pattern
+    // whenever a trip would overtake the last trip of every existing one
+    //
+    network.pattern_stop_offsets.push_back(0);
+    network.pattern_trip_offsets.push_back(0);
+    for ( auto &layout_trips: trips_by_layout ) {
+        const auto &key = layout_trips.first;
+        auto &trips = layout_trips.second;
+        size_t length = key.size();
+        size_t first_timed = 0;
+        while ( !(key[first_timed] & 2) ) {
+            first_timed++;
+        }
+        stable_sort(trips.begin(), trips.end(), [&timetable, &stop_times, first_timed](Trip_Index a, Trip_Index b) {
+                return stop_times.depart[timetable.trip_offsets[a] + first_timed] <
+                       stop_times.depart[timetable.trip_offsets[b] + first_timed];
+            });
+
+        vector<vector<Trip_Index>> patterns;
+        for ( auto trip: trips ) {
+            auto pattern = find_if(patterns.begin(), patterns.end(), [&timetable, trip, length](const vector<Trip_Index> &pattern) {
+                    return runs_behind(timetable, pattern.back(), trip, length);
+                });
+            if ( pattern == patterns.end() ) {
+                patterns.emplace_back();
+                pattern = patterns.end() - 1;
+            }
+            pattern->push_back(trip);
+        }
+
+        for ( const auto &pattern: patterns ) {
+            for ( auto stop_and_timing: key ) {
+                network.pattern_stops.push_back(stop_and_timing / 4);
+            }
+            network.pattern_stop_offsets.push_back(network.pattern_stops.size());
+            network.pattern_trips.insert(network.pattern_trips.end(), pattern.begin(), pattern.end());
+            network.pattern_trip_offsets.push_back(network.pattern_trips.size());
+        }
+    }
+
+    //
+    // (pattern, position) pairs at each stop
+    //
+    size_t num_stops = timetable.stops.size();
+    network.stop_pattern_offsets.assign(num_stops + 1, 0);
+    for ( auto stop: network.pattern_stops ) {
+        network.stop_pattern_offsets[stop + 1]++;
+    }
+    for ( size_t stop = 0; stop < num_stops; stop++ ) {
+        network.stop_pattern_offsets[stop + 1] += network.stop_pattern_offsets[stop];
+    }
+    vector<uint32_t> next_slot(network.stop_pattern_offsets.begin(), network.stop_pattern_offsets.end() - 1);
+    network.stop_patterns.resize(network.pattern_stops.size());
+    network.stop_pattern_positions.resize(network.pattern_stops.size());
+    for ( uint32_t pattern = 0; pattern < network.num_patterns(); pattern++ ) {
+        uint32_t first = network.pattern_stop_offsets[pattern];
+        for ( uint32_t position = 0; first + position < network.pattern_stop_offsets[pattern + 1]; position++ ) {
+            uint32_t slot = next_slot[network.pattern_stops[first + position]]++;
+            network.stop_patterns[slot] = pattern;
+            network.stop_pattern_positions[slot] = position;
+        }
+    }
+
+    //
+    // Footpaths, using the same walking limit as getting on and off
+    //
+    vector<Stop_Index> nearby_stops;
+    network.footpath_offsets.push_back(0);
+    for ( Stop_Index stop_index = 0; stop_index < (Stop_Index) num_stops; stop_index++ ) {
+        const Stop &stop = timetable.stops[stop_index];
+        nearby_stops.clear();
+        find_stops_within_distance(timetable, stop.lat, stop.lon, route_buffer, nearby_stops);
+        for ( auto nearby_stop: nearby_stops ) {
+            if ( nearby_stop != stop_index ) {
+                const Stop &neighbor = timetable.stops[nearby_stop];
+                network.footpath_stops.push_back(nearby_stop);
+                network.footpath_seconds.push_back(walking_seconds(dist_feet(stop.lat, stop.lon, neighbor.lat, neighbor.lon)));
+            }
+        }
+        network.footpath_offsets.push_back(network.footpath_stops.size());
+    }
+}
+
+
+//
+// The best way found to reach the destination with some number of
+// vehicles: the label at the stop the walk to the destination starts
+// from.  The label is kept here because it need not be one the stop
+// keeps: a walk may beat every other way there to the destination,
+// yet leave the stop later than, say, walking there from the start.
+//
+typedef struct _raptor_target
+{
+    Gtfs_Time arrival;
+    Stop_Index stop;
+    Raptor_Label label;
+} Raptor_Target;
+
+static Journey rebuild_journey(const Timetable &timetable, const Raptor_Scratch &scratch, int round,
+                               const Raptor_Target &target)
+{
+    const Stop_Times &stop_times = timetable.stop_times;
+    const auto &labels = scratch.labels;
+    Journey journey;
+    int vehicles = 0;
+    Gtfs_Time access_seconds = 0;
+
+    Stop_Index stop = target.stop;
+    Raptor_Label label = target.label;
+    journey.legs.push_back(Journey_Leg { NO_INDEX, stop, NO_INDEX, label.arrival, target.arrival });
+    for ( ;; ) {
+        if ( label.kind == INHERITED ) {
+            label = labels[--round][stop];
+            continue;
+        }
+        if ( label.kind == ACCESS ) {
+            access_seconds = scratch.access[stop];
+            journey.legs.push_back(Journey_Leg { NO_INDEX, NO_INDEX, stop, label.arrival - access_seconds, label.arrival });
+            break;
+        }
+        Stop_Index alight_stop = stop;
+        if ( label.kind == WALK ) {
+            alight_stop = label.walk_from;
+            journey.legs.push_back(Journey_Leg { NO_INDEX, alight_stop, stop, stop_times.arrive[label.alight_row], label.arrival });
+        }
+        journey.legs.push_back(Journey_Leg { label.trip, label.board_stop, alight_stop,
+                                             stop_times.depart[label.board_row], stop_times.arrive[label.alight_row] });
+        vehicles++;
+        stop = label.board_stop;
+        label = labels[--round][stop];
+    }
+    reverse(journey.legs.begin(), journey.legs.end());
+
+    //
+    // Nobody needs to stand at the first stop any longer than it takes
+    // to catch the first vehicle, so report the latest start that works
+    //
+    if ( journey.legs.size() > 1 ) {
+        journey.legs[0].arrive = journey.legs[1].depart;
+        journey.legs[0].depart = journey.legs[0].arrive - access_seconds;
+    }
+
+    journey.depart = journey.legs.front().depart;
+    journey.arrive = journey.legs.back().arrive;
+    journey.transfers = max(0, vehicles - 1);
+    return journey;
+}
+
+//
+// Make scratch ready for a search: allocate it if it was sized for
+// another timetable, else undo what the last search left behind.
+// Cleaning up here rather than at the end of a search means a search
+// that never finished can't spoil the next one.
+//
+static void reset_scratch(const Timetable &timetable, const Raptor_Network &network, int rounds,
+                          Raptor_Scratch &scratch)
+{
+    static const Raptor_Label unreached { UNREACHED, UNREACHED, INHERITED, NO_INDEX, NO_INDEX, 0, 0, NO_INDEX };
+    size_t num_stops = timetable.stops.size();
+
+    if ( scratch.is_reached.size() != num_stops || scratch.pattern_first.size() != network.num_patterns() ) {
+        scratch = Raptor_Scratch();
+        scratch.access.assign(num_stops, UNREACHED);
+        scratch.egress.assign(num_stops, UNREACHED);
+        scratch.is_marked.assign(num_stops, 0);
+        scratch.is_improved.assign(num_stops, 0);
+        scratch.is_reached.assign(num_stops, 0);
+        scratch.is_ridden.assign(num_stops, 0);
+        scratch.pattern_first.assign(network.num_patterns(), UINT32_MAX);
+    }
+    else {
+        for ( auto stop: scratch.reached ) {
+            for ( size_t round = 0; round < scratch.labels.size(); round++ ) {
+                scratch.labels[round][stop] = unreached;
+                scratch.rides[round][stop] = unreached;
+            }
+            scratch.is_reached[stop] = 0;
+        }
+        for ( auto stop: scratch.access_stops ) {
+            scratch.access[stop] = UNREACHED;
+        }
+        for ( auto stop: scratch.egress_stops ) {
+            scratch.egress[stop] = UNREACHED;
+        }
+        for ( auto stop: scratch.marked ) {
+            scratch.is_marked[stop] = 0;
+        }
+        for ( auto stop: scratch.improved ) {
+            scratch.is_improved[stop] = 0;
+        }
+        for ( auto stop: scratch.ridden_stops ) {
+            scratch.is_ridden[stop] = 0;
+        }
+        for ( auto pattern: scratch.touched_patterns ) {
+            scratch.pattern_first[pattern] = UINT32_MAX;
+        }
+    }
+
+    if ( scratch.labels.size() < (size_t) rounds + 1 ) {
+        scratch.labels.resize(rounds + 1, vector<Raptor_Label>(num_stops, unreached));
+        scratch.rides.resize(rounds + 1, vector<Raptor_Label>(num_stops, unreached));
+    }
+    scratch.reached.clear();
+    scratch.marked.clear();
+    scratch.improved.clear();
+    scratch.ridden_stops.clear();
+    scratch.touched_patterns.clear();
+    scratch.access_stops.clear();
+    scratch.egress_stops.clear();
+    scratch.departures.clear();
+}
+
+//
+// Note that a stop's labels changed in some round: they must be copied
+// up into the later rounds, and cleaned up after the search
+//
+static void note_improved(Raptor_Scratch &scratch, Stop_Index stop)
+{
+    if ( !scratch.is_improved[stop] ) {
+        scratch.is_improved[stop] = 1;
+        scratch.improved.push_back(stop);
+        if ( !scratch.is_reached[stop] ) {
+            scratch.is_reached[stop] = 1;
+            scratch.reached.push_back(stop);
+        }
+    }
+}
+
+static void mark(Raptor_Scratch &scratch, Stop_Index stop)
+{
+    if ( !scratch.is_marked[stop] ) {
+        scratch.is_marked[stop] = 1;
+        scratch.marked.push_back(stop);
+    }
+}
+
+//
+// Keep every round at least as good as the one before it: a journey
+// with fewer vehicles is also a journey with at most this many.  Only
+// stops improved since the sweep moved to the current departure can
+// need it.
+//
+static void inherit_improved_labels(Raptor_Scratch &scratch, int round)
+{
+    for ( auto stop: scratch.improved ) {
+        const Raptor_Label &previous = scratch.labels[round - 1][stop];
+        if ( previous.ready < scratch.labels[round][stop].ready ) {
+            scratch.labels[round][stop] = previous;
+            scratch.labels[round][stop].kind = INHERITED;
+        }
+        const Raptor_Label &previous_ride = scratch.rides[round - 1][stop];
+        if ( previous_ride.arrival < scratch.rides[round][stop].arrival ) {
+            scratch.rides[round][stop] = previous_ride;
+            scratch.rides[round][stop].kind = INHERITED;
+        }
+    }
+}
+
+//
+// A new way to reach stop in this round, by vehicle or on foot after
+// one.  The stop keeps it if it gets us onto the next vehicle sooner;
+// it may improve the journey to the destination either way.
+//
+static void offer_label(Raptor_Scratch &scratch, int round, Stop_Index stop, const Raptor_Label &label,
+                        /* in/out */ Raptor_Target &target)
+{
+    Gtfs_Time egress = scratch.egress[stop];
+    if ( egress != UNREACHED && label.arrival + egress < target.arrival ) {
+        target = Raptor_Target { label.arrival + egress, stop, label };
+    }
+    if ( label.ready < scratch.labels[round][stop].ready ) {
+        scratch.labels[round][stop] = label;
+        note_improved(scratch, stop);
+        mark(scratch, stop);
+    }
+}
+
+//
+// RAPTOR rounds for each departure time in scratch.departures, latest
+// first.  This is rRAPTOR, from the same paper.  Labels are not reset
+// between departures.  Anything reachable leaving later is reachable
+// leaving earlier, by waiting, so a later departure's labels are valid
+// bounds for an earlier one, and each departure only pays for what it
+// improves.  For the same reason, labels are compared round by round
+// rather than against the best arrival over all rounds.  Otherwise a
+// later departure's many-transfer journey could hide an earlier one
+// with fewer transfers.
+//
+// Each stop has two labels per round.  labels is the best way to be
+// ready to board there; rides is the earliest arrival there by
+// vehicle, which is where transfer walks start.  Footpaths are single
+// hops within route_buffer, not closed under walking on, so the two
+// can't be one label: an earlier arrival on foot must not hide a ride
+// to the stop, or the walks on from it would never be tried.
+//
+// A journey is reported when a departure improves the best arrival
+// for some number of vehicles, and that beats every journey with
+// fewer.  That is exactly the Pareto set over (departure, arrival,
+// transfers).
+//
+static vector<Journey> raptor_sweep(const Timetable &timetable, const Raptor_Network &network,
+                                    Gtfs_Time direct_seconds, int rounds, Raptor_Scratch &scratch)
+{
+    static const Raptor_Target unreached { UNREACHED, NO_INDEX, {} };
+    const Stop_Times &stop_times = timetable.stop_times;
+    vector<Journey> journeys;
+    auto &labels = scratch.labels;
+    auto &marked = scratch.marked;
+    auto &pattern_first = scratch.pattern_first;
+    auto &touched_patterns = scratch.touched_patterns;
+    auto &ridden_stops = scratch.ridden_stops;
+
+    //
+    // Best arrival at the destination using at most k vehicles, over
+    // the departures swept so far
+    //
+    vector<Raptor_Target> target(rounds + 1, unreached);
+    vector<Gtfs_Time> previous_target(rounds + 1);
+
+    for ( auto departure: scratch.departures ) {
+        for ( int round = 0; round <= rounds; round++ ) {
+            previous_target[round] = target[round].arrival;
+        }
+        for ( auto stop: marked ) {
+            scratch.is_marked[stop] = 0;
+        }
+        marked.clear();
+        for ( auto stop: scratch.improved ) {
+            scratch.is_improved[stop] = 0;
+        }
+        scratch.improved.clear();
+
+        //
+        // Round 0: walk to the stops near the starting point, or all
+        // the way
+        //
+        if ( direct_seconds != UNREACHED ) {
+            target[0].arrival = min(target[0].arrival, departure + direct_seconds);
+        }
+        for ( auto stop: scratch.access_stops ) {
+            Gtfs_Time arrival = departure + scratch.access[stop];
+            if ( arrival < labels[0][stop].ready ) {
+                labels[0][stop] = Raptor_Label { arrival, arrival, ACCESS, NO_INDEX, NO_INDEX, 0, 0, NO_INDEX };
+                note_improved(scratch, stop);
+                mark(scratch, stop);
+            }
+        }
+
+        int round = 1;
+        for ( ; round <= rounds && !marked.empty(); round++ ) {
+            auto &previous = labels[round - 1];
+            auto &rides = scratch.rides[round];
+            inherit_improved_labels(scratch, round);
+            if ( target[round - 1].arrival < target[round].arrival ) {
+                target[round] = target[round - 1];
+            }
+
+            //
+            // Collect the patterns serving stops improved last round, and
+            // the earliest position on each where we might hop on
+            //
+            for ( auto stop: marked ) {
+                scratch.is_marked[stop] = 0;
+                for ( uint32_t slot = network.stop_pattern_offsets[stop]; slot < network.stop_pattern_offsets[stop + 1]; slot++ ) {
+                    uint32_t pattern = network.stop_patterns[slot];
+                    if ( pattern_first[pattern] == UINT32_MAX ) {
+                        touched_patterns.push_back(pattern);
+                    }
+                    pattern_first[pattern] = min(pattern_first[pattern], network.stop_pattern_positions[slot]);
+                }
+            }
+            marked.clear();
+
+            //
+            // Ride each pattern from there to its last stop
+            //
+            for ( auto pattern: touched_patterns ) {
+                uint32_t stops_begin = network.pattern_stop_offsets[pattern];
+                uint32_t length = network.pattern_stop_offsets[pattern + 1] - stops_begin;
+                auto trips_begin = network.pattern_trips.begin() + network.pattern_trip_offsets[pattern];
+                auto trips_end = network.pattern_trips.begin() + network.pattern_trip_offsets[pattern + 1];
+                auto riding = trips_end;
+                Stop_Index board_stop = NO_INDEX;
+                uint32_t board_row = 0;
+
+                for ( uint32_t position = pattern_first[pattern]; position < length; position++ ) {
+                    Stop_Index stop = network.pattern_stops[stops_begin + position];
+                    if ( riding != trips_end ) {
+                        uint32_t row = timetable.trip_offsets[*riding] + position;
+                        Gtfs_Time arrival = stop_times.arrive[row];
+                        if ( arrival != NO_TIME && arrival < rides[stop].arrival && arrival < target[round].arrival ) {
+                            rides[stop] = Raptor_Label { arrival, arrival + network.transfer_slack, RIDE,
+                                                         *riding, board_stop, board_row, row, NO_INDEX };
+                            note_improved(scratch, stop);
+                            if ( !scratch.is_ridden[stop] ) {
+                                scratch.is_ridden[stop] = 1;
+                                ridden_stops.push_back(stop);
+                            }
+                            offer_label(scratch, round, stop, rides[stop], target[round]);
+                        }
+                    }
+
+                    //
+                    // Can we catch an earlier trip here than the one we're on?
+                    //
+                    Gtfs_Time ready = previous[stop].ready;
+                    if ( ready == UNREACHED || position + 1 == length ||
+                         stop_times.depart[timetable.trip_offsets[*trips_begin] + position] == NO_TIME ) {
+                        continue;
+                    }
+                    auto catchable = lower_bound(trips_begin, riding, ready, [&timetable, &stop_times, position](Trip_Index trip, Gtfs_Time time) {
+                            return stop_times.depart[timetable.trip_offsets[trip] + position] < time;
+                        });
+                    if ( catchable != riding ) {
+                        riding = catchable;
+                        board_stop = stop;
+                        board_row = timetable.trip_offsets[*riding] + position;
+                    }
+                }
+                pattern_first[pattern] = UINT32_MAX;
+            }
+            touched_patterns.clear();
+
+            //
+            // Walk on from the stops just reached by vehicle
+            //
+            for ( auto from: ridden_stops ) {
+                scratch.is_ridden[from] = 0;
+                const Raptor_Label &ride = rides[from];
+                for ( uint32_t slot = network.footpath_offsets[from]; slot < network.footpath_offsets[from + 1]; slot++ ) {
+                    Gtfs_Time arrival = ride.arrival + network.footpath_seconds[slot];
+                    if ( arrival < target[round].arrival ) {
+                        offer_label(scratch, round, network.footpath_stops[slot],
+                                    Raptor_Label { arrival, arrival + network.transfer_slack, WALK,
+                                                   ride.trip, ride.board_stop, ride.board_row, ride.alight_row, from },
+                                    target[round]);
+                    }
+                }
+            }
+            ridden_stops.clear();
+        }
+
+        //
+        // Rounds this departure never got to must still see what it improved
+        //
+        for ( ; round <= rounds; round++ ) {
+            inherit_improved_labels(scratch, round);
+            if ( target[round - 1].arrival < target[round].arrival ) {
+                target[round] = target[round - 1];
+            }
+        }
+
+        //
+        // Journeys with this many vehicles only matter if they beat
+        // everything leaving later, and everything with fewer vehicles
+        //
+        for ( int vehicles = 1; vehicles <= rounds; vehicles++ ) {
+            if ( target[vehicles].arrival < previous_target[vehicles] && target[vehicles].arrival < target[vehicles - 1].arrival ) {
+                journeys.push_back(rebuild_journey(timetable, scratch, vehicles, target[vehicles]));
+            }
+        }
+    }
+
+    return journeys;
+}
+
+//
+// Everything about the starting point and destination that doesn't
+// depend on when we leave.  Returns how long walking all the way
+// takes, or UNREACHED if it's too far.
+//
+static Gtfs_Time prepare_endpoints(const Timetable &timetable, const Raptor_Network &network,
+                                   double start_lat, double start_lon, double dest_lat, double dest_lon,
+                                   Raptor_Scratch &scratch)
+{
+    find_stops_within_distance(timetable, dest_lat, dest_lon, network.route_buffer, scratch.egress_stops);
+    for ( auto stop_index: scratch.egress_stops ) {
+        const Stop &stop = timetable.stops[stop_index];
+        scratch.egress[stop_index] = walking_seconds(dist_feet(stop.lat, stop.lon, dest_lat, dest_lon));
+    }
+
+    find_stops_within_distance(timetable, start_lat, start_lon, network.route_buffer, scratch.access_stops);
+    for ( auto stop_index: scratch.access_stops ) {
+        const Stop &stop = timetable.stops[stop_index];
+        scratch.access[stop_index] = walking_seconds(dist_feet(start_lat, start_lon, stop.lat, stop.lon));
+    }
+
+    double direct_feet = dist_feet(start_lat, start_lon, dest_lat, dest_lon);
+    return direct_feet < network.route_buffer ? walking_seconds(direct_feet) : UNREACHED;
+}
+
+static Journey walking_journey(Gtfs_Time depart, Gtfs_Time walk_seconds)
+{
+    return Journey { depart, depart + walk_seconds, 0,
+                     { Journey_Leg { NO_INDEX, NO_INDEX, NO_INDEX, depart, depart + walk_seconds } } };
+}
+
+vector<Journey> raptor_earliest_arrival(const Timetable &timetable, const Raptor_Network &network,
+                                        double start_lat, double start_lon, Gtfs_Time start_time,
+                                        double dest_lat, double dest_lon, int max_transfers)
+{
+    Raptor_Scratch scratch;
+    return raptor_earliest_arrival(timetable, network, start_lat, start_lon, start_time,
+                                   dest_lat, dest_lon, max_transfers, scratch);
+}
+
+vector<Journey> raptor_earliest_arrival(const Timetable &timetable, const Raptor_Network &network,
+                                        double start_lat, double start_lon, Gtfs_Time start_time,
+                                        double dest_lat, double dest_lon, int max_transfers,
+                                        Raptor_Scratch &scratch)
+{
+    int rounds = max(0, max_transfers) + 1;
+    reset_scratch(timetable, network, rounds, scratch);
+    Gtfs_Time direct_seconds = prepare_endpoints(timetable, network, start_lat, start_lon, dest_lat, dest_lon, scratch);
+
+    vector<Journey> journeys;
+    if ( direct_seconds != UNREACHED ) {
+        journeys.push_back(walking_journey(start_time, direct_seconds));
+    }
+    scratch.departures.push_back(start_time);
+    auto rides = raptor_sweep(timetable, network, direct_seconds, rounds, scratch);
+    journeys.insert(journeys.end(), rides.begin(), rides.end());
+    return journeys;
+}
+
+vector<Journey> raptor_profile(const Timetable &timetable, const Raptor_Network &network,
+                               double start_lat, double start_lon, Gtfs_Time earliest_start, Gtfs_Time latest_start,
+                               double dest_lat, double dest_lon, int max_transfers,
+                               Raptor_Scratch &scratch)
+{
+    int rounds = max(0, max_transfers) + 1;
+    reset_scratch(timetable, network, rounds, scratch);
+    Gtfs_Time direct_seconds = prepare_endpoints(timetable, network, start_lat, start_lon, dest_lat, dest_lon, scratch);
+
+    vector<Journey> journeys;
+    if ( direct_seconds != UNREACHED ) {
+        journeys.push_back(walking_journey(earliest_start, direct_seconds));
+    }
+
+    //
+    // Leaving at the close of the window, the first vehicles may well
+    // leave after it.  Earlier than that, the only start times worth
+    // trying leave just enough time to walk to some vehicle leaving an
+    // access stop; any other does no better than the next of these.
+    //
+    const auto &depart = timetable.stop_times.depart;
+    scratch.departures.push_back(latest_start);
+    for ( auto stop: scratch.access_stops ) {
+        auto first = timetable.stop_departures.begin() + timetable.stop_offsets[stop];
+        auto last = timetable.stop_departures.begin() + timetable.stop_offsets[stop + 1];
+        Gtfs_Time walk = scratch.access[stop];
+        first = lower_bound(first, last, earliest_start + walk, [&depart](uint32_t row, Gtfs_Time time) { return depart[row] < time; });
+        for ( auto slot = first; slot != last && depart[*slot] <= latest_start + walk; slot++ ) {
+            scratch.departures.push_back(depart[*slot] - walk);
+        }
+    }
+    sort(scratch.departures.begin(), scratch.departures.end(), greater<Gtfs_Time>());
+    scratch.departures.erase(unique(scratch.departures.begin(), scratch.departures.end()), scratch.departures.end());
+
+    //
+    // The sweep runs from the latest departure back; report from the earliest
+    //
+    auto rides = raptor_sweep(timetable, network, direct_seconds, rounds, scratch);
+    stable_sort(rides.begin(), rides.end(), [](const Journey &a, const Journey &b) { return a.depart < b.depart; });
+    journeys.insert(journeys.end(), rides.begin(), rides.end());
+    return journeys;
+}
+
+
+static void print_stop(const Timetable &timetable, Stop_Index stop_index, const char *otherwise, ostream &out)
+{
+    if ( stop_index == NO_INDEX ) {
+        out << otherwise;
+    }
+    else {
+        const Stop &stop = timetable.stops[stop_index];
+        out << stop.name << " (id " << stop.id << ")";
+    }
+}
+
+void print_journey(const Timetable &timetable, const Journey &journey, ostream &out)
+{
+    out << "  Depart " << format_gtfs_time(journey.depart) << ", arrive " << format_gtfs_time(journey.arrive)
+        << ", " << journey.transfers << " transfer(s):" << endl;
+    for ( const auto &leg: journey.legs ) {
+        out << "    " << format_gtfs_time(leg.depart) << " - " << format_gtfs_time(leg.arrive) << "  ";
+        if ( leg.trip == NO_INDEX ) {
+            out << "Walk from ";
+        }
+        else {
+            const Trip &trip = timetable.trips[leg.trip];
+            out << "Ride ";
+            if ( trip.route != NO_INDEX ) {
+                out << "route " << timetable.routes[trip.route].short_name << " ";
+            }
+            out << "(trip " << trip.id << " toward " << trip.headsign << ") from ";
+        }
+        print_stop(timetable, leg.from, "starting point", out);
+        out << " to ";
+        print_stop(timetable, leg.to, "destination", out);
+        out << endl;
+    }
+}
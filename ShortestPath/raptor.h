@@ -0,0 +1,173 @@
+#pragma once
+
+#include <vector>
+#include <iostream>
+#include "parse_gtfs.h"
+
+//
+// RAPTOR (Round-bAsed Public Transit Optimized Router, Delling,
+// Pajor & Werneck 2012) answers earliest-arrival queries directly on
+// the timetable, in rounds: round k finds the best arrival at every
+// stop using exactly k vehicles.  Unlike the hub expansion in
+// optimize_path.c++, it produces actual itineraries, and each round
+// only touches the trips serving stops improved by the round before.
+//
+
+//
+// Used to turn walking distances into walking times
+//
+const double WALKING_FEET_PER_SECOND = 4.4;   // 3 miles per hour
+
+//
+// Everything RAPTOR needs that does not depend on the query, built
+// once per timetable and walking distance:
+//
+//   patterns:  trips visiting the same stops in the same order (with
+//              the same stops timed), sorted by departure, split so
+//              that no trip overtakes another.  A pattern's trips
+//              share the column layout of the timetable, so trip T at
+//              position i is stop_times row trip_offsets[T] + i.
+//   footpaths: for each stop, the other stops within walking distance
+//              and the time it takes to walk there.
+//
+typedef struct _raptor_network
+{
+    std::vector<uint32_t> pattern_stop_offsets;   // stops of pattern P: pattern_stops[offsets[P] .. offsets[P+1])
+    std::vector<Stop_Index> pattern_stops;
+    std::vector<uint32_t> pattern_trip_offsets;   // trips of pattern P, earliest first
+    std::vector<Trip_Index> pattern_trips;
+
+    std::vector<uint32_t> stop_pattern_offsets;   // (pattern, position) pairs serving each stop
+    std::vector<uint32_t> stop_patterns;
+    std::vector<uint32_t> stop_pattern_positions;
+
+    std::vector<uint32_t> footpath_offsets;
+    std::vector<Stop_Index> footpath_stops;
+    std::vector<Gtfs_Time> footpath_seconds;
+
+    double route_buffer;           // Longest walk considered, in feet
+    Gtfs_Time transfer_slack;      // Cushion required between vehicles, in seconds
+
+    size_t num_patterns() const { return pattern_stop_offsets.empty() ? 0 : pattern_stop_offsets.size() - 1; }
+} Raptor_Network;
+
+//
+// One leg of a journey: a ride on a trip, or a walk (trip == NO_INDEX).
+// The starting point and destination are not stops, so a walk from the
+// start has from == NO_INDEX, and a walk to the destination has
+// to == NO_INDEX.
+//
+typedef struct _journey_leg
+{
+    Trip_Index trip;
+    Stop_Index from;
+    Stop_Index to;
+    Gtfs_Time depart;
+    Gtfs_Time arrive;
+} Journey_Leg;
+
+typedef struct _journey
+{
+    Gtfs_Time depart;
+    Gtfs_Time arrive;
+    int transfers;
+    std::vector<Journey_Leg> legs;
+} Journey;
+
+//
+// How a stop was reached in a given round.  INHERITED means "no better
+// than in the round before"; look there for the details.
+//
+enum label_kinds : uint8_t
+{
+    INHERITED,
+    ACCESS,
+    RIDE,
+    WALK
+};
+
+//
+// A WALK label carries the ride that preceded the walk, so a journey
+// can be rebuilt even if the stop the walk started from is later
+// overwritten by a better label.
+//
+typedef struct _raptor_label
+{
+    Gtfs_Time arrival;
+    Gtfs_Time ready;          // Earliest time to board from here (arrival plus any transfer slack)
+    label_kinds kind;
+    Trip_Index trip;
+    Stop_Index board_stop;
+    uint32_t board_row;
+    uint32_t alight_row;
+    Stop_Index walk_from;
+} Raptor_Label;
+
+//
+// Working state of one query, sized for one timetable and network.
+// A thread answering many queries keeps one of these and passes it to
+// every search: it is allocated on first use, and each search only
+// resets the entries the search before it touched.  Never share one
+// between threads running at the same time.
+//
+typedef struct _raptor_scratch
+{
+    std::vector<std::vector<Raptor_Label>> labels;   // labels[round][stop]: soonest ready to board there
+    std::vector<std::vector<Raptor_Label>> rides;    // rides[round][stop]: earliest arrival there by vehicle
+    std::vector<Gtfs_Time> access;                   // Walk from the starting point to each stop
+    std::vector<Gtfs_Time> egress;                   // Walk from each stop to the destination
+    std::vector<char> is_marked;
+    std::vector<Stop_Index> marked;                  // Stops improved in the current round
+    std::vector<char> is_improved;
+    std::vector<Stop_Index> improved;                // Stops improved for the current departure, any round
+    std::vector<char> is_reached;
+    std::vector<Stop_Index> reached;                 // Stops with a label in any round
+    std::vector<Gtfs_Time> departures;               // Departure times to sweep, latest first
+    std::vector<uint32_t> pattern_first;             // Earliest position to board each touched pattern
+    std::vector<uint32_t> touched_patterns;
+    std::vector<Stop_Index> access_stops;
+    std::vector<Stop_Index> egress_stops;
+    std::vector<char> is_ridden;
+    std::vector<Stop_Index> ridden_stops;            // Stops reached by vehicle in the current round
+} Raptor_Scratch;
+
+extern void build_raptor_network(const Timetable &timetable, double route_buffer, double time_buffer,
+                                 /* out */ Raptor_Network &network);
+
+//
+// Journeys leaving (start_lat, start_lon) no earlier than start_time,
+// one per transfer count that arrives strictly earlier than every
+// journey with fewer transfers -- i.e. the Pareto set over (arrival,
+// transfers).  At most max_transfers transfers are considered.
+//
+extern std::vector<Journey> raptor_earliest_arrival(const Timetable &timetable, const Raptor_Network &network,
+                                                    double start_lat, double start_lon, Gtfs_Time start_time,
+                                                    double dest_lat, double dest_lon, int max_transfers);
+
+//
+// The same search, reusing the caller's scratch state.  Timetable and
+// network are only read, so any number of threads may search them at
+// once, each with its own scratch.
+//
+extern std::vector<Journey> raptor_earliest_arrival(const Timetable &timetable, const Raptor_Network &network,
+                                                    double start_lat, double start_lon, Gtfs_Time start_time,
+                                                    double dest_lat, double dest_lon, int max_transfers,
+                                                    /* in/out */ Raptor_Scratch &scratch);
+
+//
+// Profile query: the journeys raptor_earliest_arrival would find for
+// any start time from earliest_start to latest_start, less those some
+// other journey beats on all of leaving later, arriving earlier and
+// transferring less -- i.e. the Pareto set over (departure, arrival,
+// transfers) -- in order of departure.  The last may leave after
+// latest_start, if nothing leaves sooner.  Walking all the way, if
+// close enough, is listed first, leaving at earliest_start.  The
+// window is one sweep, costing a few single searches, not one per
+// minute of window.
+//
+extern std::vector<Journey> raptor_profile(const Timetable &timetable, const Raptor_Network &network,
+                                           double start_lat, double start_lon, Gtfs_Time earliest_start, Gtfs_Time latest_start,
+                                           double dest_lat, double dest_lon, int max_transfers,
+                                           /* in/out */ Raptor_Scratch &scratch);
+
+extern void print_journey(const Timetable &timetable, const Journey &journey, std::ostream &out);
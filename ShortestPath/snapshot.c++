@@ -0,0 +1,504 @@
+//
+// Timetable snapshots
+//
+// Parsing five CSV files takes most of the wall-clock time of a run on
+// a big feed, and it produces the same Timetable every time.  So the
+// Timetable can be written out once (--compile) and mapped back in on
+// later runs.
+//
+// FILE LAYOUT (native byte order; a marker in the header rejects
+// files from a machine with the other one)
+//
+//   Snapshot_Header    magic, version, checksum, file size
+//   Snapshot_Section   one per snapshot_sections entry, in order
+//   section data       each section starts on an 8-byte boundary
+//
+// The checksum covers everything after the header.  Strings live in a
+// single pool (characters plus offsets), and records refer to them by
+// number.  Bump SNAPSHOT_VERSION whenever the layout or any of the
+// Timetable types change; older files are then ignored and rebuilt.
+//
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <vector>
+#include <chrono>
+#include <string.h>
+#include "parse_gtfs.h"
+#include "parse_csv.h"
+#include "snapshot.h"
+
+using namespace std;
+
+const char SNAPSHOT_MAGIC[8] = { 'G', 'T', 'F', 'S', 'S', 'N', 'A', 'P' };
+const uint32_t SNAPSHOT_VERSION = 1;
+const uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304;
+
+const char * const GTFS_FILENAMES[] = { "agency.txt", "routes.txt", "stops.txt", "trips.txt", "stop_times.txt" };
+
+enum snapshot_sections : uint32_t
+{
+    STRING_CHARS,
+    STRING_OFFSETS,
+    AGENCY_STRINGS,        // id, name, email
+    ROUTE_STRINGS,         // id, short_name, long_name, desc
+    STOP_STRINGS,          // id, code, name
+    STOP_POSITIONS,        // lat, lon
+    TRIP_ROUTES,
+    TRIP_STRINGS,          // id, headsign
+    STOP_TIME_TRIP,
+    STOP_TIME_STOP,
+    STOP_TIME_ARRIVE,
+    STOP_TIME_DEPART,
+    STOP_TIME_SEQUENCE,
+    TRIP_OFFSETS,
+    STOP_OFFSETS,
+    STOP_DEPARTURES,
+    GRID_SHAPE,            // south, west, cell_degrees, rows, columns
+    GRID_CELL_OFFSETS,
+    GRID_STOP,
+    GRID_X,
+    GRID_Y,
+    GRID_Z,
+    NUM_SECTIONS
+};
+
+typedef struct _snapshot_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t checksum;
+    uint64_t file_size;
+    uint32_t num_sections;
+    uint32_t reserved;
+} Snapshot_Header;
+
+typedef struct _snapshot_section
+{
+    uint32_t id;
+    uint32_t element_size;
+    uint64_t offset;
+    uint64_t count;
+} Snapshot_Section;
+
+//
+// Word-at-a-time multiply/xor hash: only meant to catch truncated or
+// damaged files, and quick enough to run on every load
+//
+static uint64_t snapshot_checksum(const char *data, size_t length)
+{
+    uint64_t hash = 0x9e3779b97f4a7c15ULL ^ length;
+    size_t i = 0;
+    for ( ; i + 8 <= length; i += 8 ) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * 0x100000001b3ULL;
+        hash ^= hash >> 29;
+    }
+    for ( ; i < length; i++ ) {
+        hash = (hash ^ (unsigned char) data[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+
+//
+// Accumulates the sections of a snapshot in memory
+//
+class Snapshot_Writer
+{
+public:
+    uint32_t add_string(const string &text)
+    {
+        strings.append(text);
+        string_offsets.push_back(strings.size());
+        return string_offsets.size() - 2;
+    }
+
+    template <typename T>
+    void add_section(snapshot_sections id, const T *elements, size_t count)
+    {
+        payload.resize((payload.size() + 7) & ~(size_t) 7, '\0');
+        sections[id] = Snapshot_Section { id, sizeof(T), payload.size(), count };
+        payload.append(reinterpret_cast<const char *>(elements), count * sizeof(T));
+    }
+
+    template <typename Container>
+    void add_section(snapshot_sections id, const Container &elements)
+    {
+        add_section(id, elements.data(), elements.size());
+    }
+
+    bool write(const string &path)
+    {
+        add_section(STRING_CHARS, strings);
+        add_section(STRING_OFFSETS, string_offsets);
+
+        //
+        // Section offsets so far are relative to the payload; make them
+        // relative to the start of the file
+        //
+        uint64_t data_start = (sizeof(Snapshot_Header) + sizeof(sections) + 7) & ~(uint64_t) 7;
+        for ( auto &section: sections ) {
+            section.offset += data_start;
+        }
+
+        string body(reinterpret_cast<const char *>(sections), sizeof(sections));
+        body.resize(data_start - sizeof(Snapshot_Header), '\0');
+        body.append(payload);
+
+        Snapshot_Header header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+        header.version = SNAPSHOT_VERSION;
+        header.byte_order = SNAPSHOT_BYTE_ORDER;
+        header.checksum = snapshot_checksum(body.data(), body.size());
+        header.file_size = sizeof(header) + body.size();
+        header.num_sections = NUM_SECTIONS;
+
+        //
+        // Write beside the real file and rename, so a reader never
+        // maps a half-written snapshot
+        //
+        string temporary_path = path + ".tmp";
+        ofstream snapshot_file(temporary_path, ios::binary | ios::trunc);
+        snapshot_file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        snapshot_file.write(body.data(), body.size());
+        snapshot_file.close();
+        error_code error;
+        if ( !snapshot_file ) {
+            cerr << "Error writing snapshot <" << temporary_path << ">: " << strerror(errno) << endl;
+            filesystem::remove(temporary_path, error);
+            return false;
+        }
+        filesystem::rename(temporary_path, path, error);
+        if ( error ) {
+            cerr << "Error replacing snapshot <" << path << ">: " << error.message() << endl;
+            filesystem::remove(temporary_path, error);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    string strings;
+    vector<uint64_t> string_offsets { 0 };
+    Snapshot_Section sections[NUM_SECTIONS] {};
+    string payload;
+};
+
+bool write_gtfs_snapshot(const Timetable &timetable, string path)
+{
+    Snapshot_Writer writer;
+
+    vector<uint32_t> agency_strings;
+    for ( const auto &agency: timetable.agencies ) {
+        agency_strings.push_back(writer.add_string(agency.id));
+        agency_strings.push_back(writer.add_string(agency.name));
+        agency_strings.push_back(writer.add_string(agency.email));
+    }
+    writer.add_section(AGENCY_STRINGS, agency_strings);
+
+    vector<uint32_t> route_strings;
+    for ( const auto &route: timetable.routes ) {
+        route_strings.push_back(writer.add_string(route.id));
+        route_strings.push_back(writer.add_string(route.short_name));
+        route_strings.push_back(writer.add_string(route.long_name));
+        route_strings.push_back(writer.add_string(route.desc));
+    }
+    writer.add_section(ROUTE_STRINGS, route_strings);
+
+    vector<uint32_t> stop_strings;
+    vector<double> stop_positions;
+    for ( const auto &stop: timetable.stops ) {
+        stop_strings.push_back(writer.add_string(stop.id));
+        stop_strings.push_back(writer.add_string(stop.code));
+        stop_strings.push_back(writer.add_string(stop.name));
+        stop_positions.push_back(stop.lat);
+        stop_positions.push_back(stop.lon);
+    }
+    writer.add_section(STOP_STRINGS, stop_strings);
+    writer.add_section(STOP_POSITIONS, stop_positions);
+
+    vector<Route_Index> trip_routes;
+    vector<uint32_t> trip_strings;
+    for ( const auto &trip: timetable.trips ) {
+        trip_routes.push_back(trip.route);
+        trip_strings.push_back(writer.add_string(trip.id));
+        trip_strings.push_back(writer.add_string(trip.headsign));
+    }
+    writer.add_section(TRIP_ROUTES, trip_routes);
+    writer.add_section(TRIP_STRINGS, trip_strings);
+
+    const Stop_Times &stop_times = timetable.stop_times;
+    writer.add_section(STOP_TIME_TRIP, stop_times.trip);
+    writer.add_section(STOP_TIME_STOP, stop_times.stop);
+    writer.add_section(STOP_TIME_ARRIVE, stop_times.arrive);
+    writer.add_section(STOP_TIME_DEPART, stop_times.depart);
+    writer.add_section(STOP_TIME_SEQUENCE, stop_times.sequence);
+    writer.add_section(TRIP_OFFSETS, timetable.trip_offsets);
+    writer.add_section(STOP_OFFSETS, timetable.stop_offsets);
+    writer.add_section(STOP_DEPARTURES, timetable.stop_departures);
+
+    const Stop_Grid &grid = timetable.stop_grid;
+    double grid_shape[] = { grid.south, grid.west, grid.cell_degrees, (double) grid.rows, (double) grid.columns };
+    writer.add_section(GRID_SHAPE, grid_shape, 5);
+    writer.add_section(GRID_CELL_OFFSETS, grid.cell_offsets);
+    writer.add_section(GRID_STOP, grid.stop);
+    writer.add_section(GRID_X, grid.x);
+    writer.add_section(GRID_Y, grid.y);
+    writer.add_section(GRID_Z, grid.z);
+
+    return writer.write(path);
+}
+
+
+//
+// Validated, typed access to the sections of a mapped snapshot
+//
+class Snapshot_Reader
+{
+public:
+    Snapshot_Reader(const Mapped_File &file) : file(file) {}
+
+    bool valid(string &complaint) const
+    {
+        if ( file.size() < sizeof(Snapshot_Header) + sizeof(Snapshot_Section) * NUM_SECTIONS ) {
+            complaint = "file is truncated";
+            return false;
+        }
+        const Snapshot_Header &header = *reinterpret_cast<const Snapshot_Header *>(file.begin());
+        if ( memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 ) {
+            complaint = "not a snapshot file";
+            return false;
+        }
+        if ( header.version != SNAPSHOT_VERSION || header.byte_order != SNAPSHOT_BYTE_ORDER ||
+             header.num_sections != NUM_SECTIONS ) {
+            complaint = "written by a different version or platform";
+            return false;
+        }
+        if ( header.file_size != file.size() ||
+             header.checksum != snapshot_checksum(file.begin() + sizeof(header), file.size() - sizeof(header)) ) {
+            complaint = "checksum mismatch";
+            return false;
+        }
+        for ( uint32_t id = 0; id < NUM_SECTIONS; id++ ) {
+            const Snapshot_Section &section = sections()[id];
+            if ( section.id != id || section.offset % 8 != 0 || section.offset > file.size() ||
+                 section.count > (file.size() - section.offset) / max<uint32_t>(section.element_size, 1) ) {
+                complaint = "section table is damaged";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    size_t count(snapshot_sections id) const
+    {
+        return sections()[id].count;
+    }
+
+    template <typename T>
+    bool section(snapshot_sections id, size_t expected_count, /* out */ const T *&elements, /* out */ size_t &count) const
+    {
+        const Snapshot_Section &section = sections()[id];
+        elements = reinterpret_cast<const T *>(file.begin() + section.offset);
+        count = section.count;
+        return section.element_size == sizeof(T) && (expected_count == SIZE_MAX || count == expected_count);
+    }
+
+    template <typename T>
+    bool borrow(snapshot_sections id, size_t expected_count, /* out */ Column<T> &column) const
+    {
+        const T *elements;
+        size_t count;
+        if ( !section(id, expected_count, elements, count) ) {
+            return false;
+        }
+        column.borrow(elements, count);
+        return true;
+    }
+
+private:
+    const Snapshot_Section *sections() const
+    {
+        return reinterpret_cast<const Snapshot_Section *>(file.begin() + sizeof(Snapshot_Header));
+    }
+
+    const Mapped_File &file;
+};
+
+bool load_gtfs_snapshot(string path, Timetable &timetable)
+{
+    error_code error;
+    if ( !filesystem::exists(path, error) ) {
+        return false;
+    }
+
+    //
+    // Mapped_File has already said why it could not open or map the file
+    //
+    shared_ptr<Mapped_File> file;
+    try {
+        file = make_shared<Mapped_File>(path);
+    }
+    catch ( const missing_file_exception &mfe ) {
+        cerr << "Ignoring snapshot <" << path << ">: " << mfe.what() << endl;
+        return false;
+    }
+    Snapshot_Reader reader(*file);
+    string complaint;
+    if ( !reader.valid(complaint) ) {
+        cerr << "Ignoring snapshot <" << path << ">: " << complaint << "." << endl;
+        return false;
+    }
+
+    const char *chars;
+    const uint64_t *offsets;
+    size_t num_chars, num_strings;
+    bool ok = reader.section(STRING_CHARS, SIZE_MAX, chars, num_chars) &&
+              reader.section(STRING_OFFSETS, SIZE_MAX, offsets, num_strings) &&
+              num_strings > 0 && offsets[num_strings - 1] <= num_chars;
+    num_strings = ok ? num_strings - 1 : 0;
+    auto text = [chars, offsets, num_strings](uint32_t string_number) {
+        return string_number < num_strings ? string(chars + offsets[string_number], offsets[string_number + 1] - offsets[string_number])
+                                           : string();
+    };
+
+    //
+    // The small tables are rebuilt as records (and lookup maps)...
+    //
+    const uint32_t *strings;
+    const double *positions;
+    const Route_Index *trip_routes;
+    size_t count, num_stops = 0, num_trips = 0;
+    if ( ok && (ok = reader.section(AGENCY_STRINGS, SIZE_MAX, strings, count)) ) {
+        for ( size_t i = 0; i + 2 < count; i += 3 ) {
+            timetable.agencies.push_back(Agency { text(strings[i]), text(strings[i + 1]), text(strings[i + 2]) });
+        }
+    }
+    if ( ok && (ok = reader.section(ROUTE_STRINGS, SIZE_MAX, strings, count)) ) {
+        timetable.routes.reserve(count / 4);
+        for ( size_t i = 0; i + 3 < count; i += 4 ) {
+            timetable.route_index[text(strings[i])] = timetable.routes.size();
+            timetable.routes.push_back(Route { text(strings[i]), text(strings[i + 1]), text(strings[i + 2]), text(strings[i + 3]) });
+        }
+    }
+    if ( ok && (ok = reader.section(STOP_STRINGS, SIZE_MAX, strings, count)) ) {
+        num_stops = count / 3;
+        ok = reader.section(STOP_POSITIONS, num_stops * 2, positions, count);
+        timetable.stops.reserve(num_stops);
+        for ( size_t i = 0; ok && i < num_stops; i++ ) {
+            timetable.stop_index[text(strings[3 * i])] = i;
+            timetable.stops.push_back(Stop { text(strings[3 * i]), text(strings[3 * i + 1]), text(strings[3 * i + 2]),
+                                             positions[2 * i], positions[2 * i + 1] });
+        }
+    }
+    if ( ok && (ok = reader.section(TRIP_ROUTES, SIZE_MAX, trip_routes, num_trips)) ) {
+        ok = reader.section(TRIP_STRINGS, num_trips * 2, strings, count);
+        timetable.trips.reserve(num_trips);
+        for ( size_t i = 0; ok && i < num_trips; i++ ) {
+            timetable.trip_index[text(strings[2 * i])] = i;
+            timetable.trips.push_back(Trip { trip_routes[i], text(strings[2 * i]), text(strings[2 * i + 1]) });
+        }
+    }
+
+    //
+    // ...while the big columns are used right where they sit in the file
+    //
+    Stop_Times &stop_times = timetable.stop_times;
+    size_t num_rows = reader.count(STOP_TIME_TRIP);
+    ok = ok && reader.borrow(STOP_TIME_TRIP, num_rows, stop_times.trip) &&
+         reader.borrow(STOP_TIME_STOP, num_rows, stop_times.stop) &&
+         reader.borrow(STOP_TIME_ARRIVE, num_rows, stop_times.arrive) &&
+         reader.borrow(STOP_TIME_DEPART, num_rows, stop_times.depart) &&
+         reader.borrow(STOP_TIME_SEQUENCE, num_rows, stop_times.sequence) &&
+         reader.borrow(TRIP_OFFSETS, num_trips + 1, timetable.trip_offsets) &&
+         reader.borrow(STOP_OFFSETS, num_stops + 1, timetable.stop_offsets) &&
+         reader.borrow(STOP_DEPARTURES, num_rows, timetable.stop_departures);
+
+    Stop_Grid &grid = timetable.stop_grid;
+    const double *grid_shape;
+    ok = ok && reader.section(GRID_SHAPE, 5, grid_shape, count);
+    if ( ok ) {
+        grid.south = grid_shape[0];
+        grid.west = grid_shape[1];
+        grid.cell_degrees = grid_shape[2];
+        grid.rows = grid_shape[3];
+        grid.columns = grid_shape[4];
+    }
+    ok = ok && reader.borrow(GRID_CELL_OFFSETS, (size_t) grid.rows * grid.columns + 1, grid.cell_offsets) &&
+         reader.borrow(GRID_STOP, SIZE_MAX, grid.stop) &&
+         reader.borrow(GRID_X, grid.stop.size(), grid.x) &&
+         reader.borrow(GRID_Y, grid.stop.size(), grid.y) &&
+         reader.borrow(GRID_Z, grid.stop.size(), grid.z);
+
+    if ( !ok ) {
+        cerr << "Ignoring snapshot <" << path << ">: sections are inconsistent." << endl;
+        timetable = Timetable();
+        return false;
+    }
+
+    timetable.snapshot = file;
+    return true;
+}
+
+bool gtfs_snapshot_is_current(string gtfs_data_folder)
+{
+    error_code error;
+    auto snapshot_time = filesystem::last_write_time(gtfs_data_folder + "/" + SNAPSHOT_FILENAME, error);
+    if ( error ) {
+        return false;
+    }
+
+    //
+    // A missing .txt file doesn't make the snapshot stale -- the
+    // snapshot may have been shipped without its sources
+    //
+    for ( auto filename: GTFS_FILENAMES ) {
+        auto source_time = filesystem::last_write_time(gtfs_data_folder + "/" + filename, error);
+        if ( !error && source_time > snapshot_time ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool load_gtfs_timetable(string gtfs_data_folder, bool compile, Timetable &timetable)
+{
+    chrono::time_point<chrono::system_clock> start, end;
+    chrono::duration<double> process_time;
+    string snapshot_path = gtfs_data_folder + "/" + SNAPSHOT_FILENAME;
+    error_code error;
+    bool have_snapshot = filesystem::exists(snapshot_path, error);
+
+    if ( have_snapshot && !compile ) {
+        if ( gtfs_snapshot_is_current(gtfs_data_folder) ) {
+            start = chrono::system_clock::now();
+            if ( load_gtfs_snapshot(snapshot_path, timetable) ) {
+                end = chrono::system_clock::now();
+                process_time = end - start;
+                cout << "Read snapshot in :    " << process_time.count() << " seconds." << endl;
+                return true;
+            }
+        }
+        else {
+            cout << "Snapshot <" << snapshot_path << "> is older than the GTFS files; rebuilding it." << endl;
+        }
+    }
+
+    bool rc = load_gtfs_system_data(gtfs_data_folder, timetable);
+
+    if ( compile || have_snapshot ) {
+        start = chrono::system_clock::now();
+        if ( write_gtfs_snapshot(timetable, snapshot_path) ) {
+            end = chrono::system_clock::now();
+            process_time = end - start;
+            cout << "Wrote snapshot in :   " << process_time.count() << " seconds." << endl;
+        }
+    }
+
+    return rc;
+}
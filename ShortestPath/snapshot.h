@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include "parse_gtfs.h"
+
+//
+// A compiled, binary image of a loaded Timetable, kept beside the GTFS
+// files.  The big columns (stop times, indexes, stop grid) are used in
+// place from the mapped file; only the small per-agency/route/stop/trip
+// records are rebuilt.
+//
+const char * const SNAPSHOT_FILENAME = "gtfs_route.snapshot";
+
+extern bool write_gtfs_snapshot(const Timetable &timetable, std::string path);
+
+extern bool load_gtfs_snapshot(std::string path, /* out */ Timetable &timetable);  // false if absent, outdated or damaged
+
+//
+// True unless one of the GTFS .txt files has changed since the snapshot was written
+//
+extern bool gtfs_snapshot_is_current(std::string gtfs_data_folder);
+
+//
+// Use the snapshot when it is current; otherwise parse the CSV files,
+// and (re)write the snapshot if one existed already or compile is set.
+//
+extern bool load_gtfs_timetable(std::string gtfs_data_folder, bool compile,
+                                /* out */ Timetable &timetable
+                                ); // Throws missing_file_exception, missing_value_exception, and unterminated_quote_exception
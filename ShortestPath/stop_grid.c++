@@ -0,0 +1,274 @@
+//
+// Spatial index for "which stops are within N feet of here?"
+//
+// The original search ran dist_feet() (three sin/cos pairs and an
+// asin) against every stop in the system, and the network expansion
+// asks that question for every stop of every trip it discovers.
+// Instead:
+//
+//   1. A uniform grid, built once at load, narrows the search to the
+//      cells overlapping a conservative bounding box.
+//   2. Each stop is stored as a point on the unit sphere.  dist_feet()
+//      is 2R * asin(chord / 2), so "closer than distance" is the same
+//      test as "chord shorter than 2 sin(distance / 2R)".  The chords
+//      need only multiply-adds, which squared_chords() does in bulk.
+//   3. Candidates whose chord lands within rounding error of the limit
+//      are settled by dist_feet() itself, so the answer is exactly the
+//      one the brute-force scan gave.
+//
+
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS
+#endif
+#include "parse_gtfs.h"
+#include "optimize_path.h"
+#include "stop_grid.h"
+#include "earth.h"
+
+using namespace std;
+
+static void squared_chords_scalar(const double *x, const double *y, const double *z, size_t count,
+                                  double qx, double qy, double qz, double *chord2)
+{
+    for ( size_t i = 0; i < count; i++ ) {
+        double dx = x[i] - qx, dy = y[i] - qy, dz = z[i] - qz;
+        chord2[i] = dx * dx + dy * dy + dz * dz;
+    }
+}
+
+#ifdef HAVE_X86_KERNELS
+__attribute__((target("avx2")))
+static void squared_chords_avx2(const double *x, const double *y, const double *z, size_t count,
+                                double qx, double qy, double qz, double *chord2)
+{
+    __m256d vqx = _mm256_set1_pd(qx), vqy = _mm256_set1_pd(qy), vqz = _mm256_set1_pd(qz);
+    size_t i = 0;
+    for ( ; i + 4 <= count; i += 4 ) {
+        __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(x + i), vqx);
+        __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(y + i), vqy);
+        __m256d dz = _mm256_sub_pd(_mm256_loadu_pd(z + i), vqz);
+        __m256d sum = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)), _mm256_mul_pd(dz, dz));
+        _mm256_storeu_pd(chord2 + i, sum);
+    }
+    squared_chords_scalar(x + i, y + i, z + i, count - i, qx, qy, qz, chord2 + i);
+}
+
+//
+// SSE2 is part of the x86-64 baseline, so this needs no CPU check
+//
+static void squared_chords_sse2(const double *x, const double *y, const double *z, size_t count,
+                                double qx, double qy, double qz, double *chord2)
+{
+    __m128d vqx = _mm_set1_pd(qx), vqy = _mm_set1_pd(qy), vqz = _mm_set1_pd(qz);
+    size_t i = 0;
+    for ( ; i + 2 <= count; i += 2 ) {
+        __m128d dx = _mm_sub_pd(_mm_loadu_pd(x + i), vqx);
+        __m128d dy = _mm_sub_pd(_mm_loadu_pd(y + i), vqy);
+        __m128d dz = _mm_sub_pd(_mm_loadu_pd(z + i), vqz);
+        __m128d sum = _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)), _mm_mul_pd(dz, dz));
+        _mm_storeu_pd(chord2 + i, sum);
+    }
+    squared_chords_scalar(x + i, y + i, z + i, count - i, qx, qy, qz, chord2 + i);
+}
+#endif
+
+typedef void (*Chord_Kernel)(const double *, const double *, const double *, size_t,
+                             double, double, double, double *);
+
+static Chord_Kernel select_chord_kernel()
+{
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports("avx2") ) {
+        return squared_chords_avx2;
+    }
+    return squared_chords_sse2;
+#else
+    return squared_chords_scalar;
+#endif
+}
+
+void squared_chords(const double *x, const double *y, const double *z, size_t count,
+                    double qx, double qy, double qz, double *chord2)
+{
+    static const Chord_Kernel kernel = select_chord_kernel();
+    kernel(x, y, z, count, qx, qy, qz, chord2);
+}
+
+
+static int32_t grid_row(const Stop_Grid &grid, double lat)
+{
+    return min(grid.rows - 1, max(0, (int32_t) floor((lat - grid.south) / grid.cell_degrees)));
+}
+
+static int32_t grid_column(const Stop_Grid &grid, double lon)
+{
+    return min(grid.columns - 1, max(0, (int32_t) floor((lon - grid.west) / grid.cell_degrees)));
+}
+
+void build_stop_grid(Timetable &timetable)
+{
+    Stop_Grid &grid = timetable.stop_grid;
+    grid = Stop_Grid();
+
+    vector<Stop_Index> located;
+    double south = HUGE_VAL, north = -HUGE_VAL, west = HUGE_VAL, east = -HUGE_VAL;
+    for ( Stop_Index stop_index = 0; stop_index < (Stop_Index) timetable.stops.size(); stop_index++ ) {
+        const Stop &stop = timetable.stops[stop_index];
+        if ( isfinite(stop.lat) && isfinite(stop.lon) ) {
+            located.push_back(stop_index);
+            south = min(south, stop.lat);
+            north = max(north, stop.lat);
+            west = min(west, stop.lon);
+            east = max(east, stop.lon);
+        }
+    }
+
+    if ( located.empty() ) {
+        grid.south = grid.west = 0.0;
+        grid.cell_degrees = 1.0;
+        grid.rows = grid.columns = 0;
+        grid.cell_offsets.assign(1, 0);
+        return;
+    }
+
+    //
+    // Aim for a couple of stops per cell.  The floors keep a feed with
+    // one stop (or with every stop along one meridian) from asking for
+    // a degenerate or enormous grid.
+    //
+    double lat_span = north - south, lon_span = east - west;
+    double cell_degrees = sqrt(lat_span * lon_span / (located.size() / 2.0 + 1));
+    cell_degrees = max(cell_degrees, max(lat_span, lon_span) / 4096);
+    cell_degrees = max(cell_degrees, 1e-4);
+
+    grid.south = south;
+    grid.west = west;
+    grid.cell_degrees = cell_degrees;
+    grid.rows = (int32_t) (lat_span / cell_degrees) + 1;
+    grid.columns = (int32_t) (lon_span / cell_degrees) + 1;
+
+    //
+    // Counting sort of the stops into cells
+    //
+    size_t num_cells = (size_t) grid.rows * grid.columns;
+    vector<uint32_t> cell_of(located.size());
+    auto &cell_offsets = grid.cell_offsets.owned();
+    cell_offsets.assign(num_cells + 1, 0);
+    for ( size_t i = 0; i < located.size(); i++ ) {
+        const Stop &stop = timetable.stops[located[i]];
+        cell_of[i] = grid_row(grid, stop.lat) * grid.columns + grid_column(grid, stop.lon);
+        cell_offsets[cell_of[i] + 1]++;
+    }
+    for ( size_t cell = 0; cell < num_cells; cell++ ) {
+        cell_offsets[cell + 1] += cell_offsets[cell];
+    }
+
+    vector<uint32_t> next_slot(cell_offsets.begin(), cell_offsets.end() - 1);
+    auto &grid_stop = grid.stop.owned();
+    auto &x = grid.x.owned(), &y = grid.y.owned(), &z = grid.z.owned();
+    grid_stop.resize(located.size());
+    x.resize(located.size());
+    y.resize(located.size());
+    z.resize(located.size());
+    for ( size_t i = 0; i < located.size(); i++ ) {
+        const Stop &stop = timetable.stops[located[i]];
+        uint32_t slot = next_slot[cell_of[i]]++;
+        double lat = stop.lat * TO_RAD, lon = stop.lon * TO_RAD;
+        grid_stop[slot] = located[i];
+        x[slot] = cos(lat) * cos(lon);
+        y[slot] = cos(lat) * sin(lon);
+        z[slot] = sin(lat);
+    }
+}
+
+void find_stops_within_distance(const Timetable &timetable, double lat, double lon, double distance,
+                                vector<Stop_Index> &stops_within_distance)
+{
+    const Stop_Grid &grid = timetable.stop_grid;
+    if ( grid.stop.empty() || !(distance > 0) || !isfinite(lat) || !isfinite(lon) ) {
+        return;
+    }
+
+    //
+    // A radius reaching the far side of the planet needs no index
+    //
+    double angle = distance / EARTH_RADIUS_FEET;
+    if ( angle >= 3.1415926536 ) {
+        for ( auto stop_index: grid.stop ) {
+            const Stop &stop = timetable.stops[stop_index];
+            if ( dist_feet(lat, lon, stop.lat, stop.lon) < distance ) {
+                stops_within_distance.push_back(stop_index);
+            }
+        }
+        return;
+    }
+
+    //
+    // Conservative bounding box.  Latitude can differ by at most the
+    // angle itself; longitude by asin(sin(angle) / cos(lat)), unless
+    // the circle reaches a pole or could wrap around to stops on the
+    // far side of +/-180, in which case every column is searched.  The
+    // margins absorb rounding.
+    //
+    double lat_margin = angle / TO_RAD * (1 + 1e-9) + 1e-9;
+    int32_t first_row = grid_row(grid, lat - lat_margin);
+    int32_t last_row = grid_row(grid, lat + lat_margin);
+    if ( lat + lat_margin < grid.south || lat - lat_margin > grid.south + grid.rows * grid.cell_degrees ) {
+        return;
+    }
+
+    int32_t first_column = 0, last_column = grid.columns - 1;
+    if ( fabs(lat) + lat_margin < 90 ) {
+        double sin_ratio = sin(angle) / cos(lat * TO_RAD);
+        if ( sin_ratio < 1 ) {
+            double lon_margin = asin(sin_ratio) / TO_RAD * (1 + 1e-9) + 1e-9;
+            double grid_east = grid.west + grid.columns * grid.cell_degrees;
+            bool wraps = lon + lon_margin - 360 >= grid.west || lon - lon_margin + 360 <= grid_east;
+            if ( !wraps ) {
+                if ( lon + lon_margin < grid.west || lon - lon_margin > grid_east ) {
+                    return;
+                }
+                first_column = grid_column(grid, lon - lon_margin);
+                last_column = grid_column(grid, lon + lon_margin);
+            }
+        }
+    }
+
+    //
+    // Squared chord limit, and the band around it where rounding in
+    // either formula could tip the answer
+    //
+    double limit = 2 * sin(angle / 2);
+    double limit2 = limit * limit;
+    double band = limit2 * 1e-9 + 1e-20;
+    double qx = cos(lat * TO_RAD) * cos(lon * TO_RAD);
+    double qy = cos(lat * TO_RAD) * sin(lon * TO_RAD);
+    double qz = sin(lat * TO_RAD);
+
+    const size_t batch = 256;
+    double chord2[batch];
+    for ( int32_t row = first_row; row <= last_row; row++ ) {
+        uint32_t first = grid.cell_offsets[row * grid.columns + first_column];
+        uint32_t last = grid.cell_offsets[row * grid.columns + last_column + 1];
+        for ( uint32_t start = first; start < last; start += batch ) {
+            size_t count = min<size_t>(batch, last - start);
+            squared_chords(&grid.x[start], &grid.y[start], &grid.z[start], count, qx, qy, qz, chord2);
+            for ( size_t i = 0; i < count; i++ ) {
+                if ( chord2[i] < limit2 - band ) {
+                    stops_within_distance.push_back(grid.stop[start + i]);
+                }
+                else if ( chord2[i] <= limit2 + band ) {
+                    const Stop &stop = timetable.stops[grid.stop[start + i]];
+                    if ( dist_feet(lat, lon, stop.lat, stop.lon) < distance ) {
+                        stops_within_distance.push_back(grid.stop[start + i]);
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <vector>
+#include "parse_gtfs.h"
+
+//
+// Build timetable.stop_grid from timetable.stops.  Stops without a
+// usable position (e.g. placeholders for undefined stop ids) are left
+// out, just as no distance test could ever accept them.
+//
+extern void build_stop_grid(Timetable &timetable);
+
+//
+// Append every stop strictly closer than distance feet to (lat, lon),
+// the same set a dist_feet() test against every stop would produce.
+//
+extern void find_stops_within_distance(const Timetable &timetable, double lat, double lon, double distance,
+                                       /* out */ std::vector<Stop_Index> &stops_within_distance);
+
+//
+// Batch kernel: chord2[i] = squared distance between (qx, qy, qz) and
+// (x[i], y[i], z[i]).  Uses AVX2 or SSE2 when the CPU has them.
+//
+extern void squared_chords(const double *x, const double *y, const double *z, size_t count,
+                           double qx, double qy, double qz, /* out */ double *chord2);
@@ -0,0 +1,192 @@
+//
+// Synthetic GTFS feeds (see synthetic_gtfs.h)
+//
+// Positions are laid out in feet around the center and only turned
+// into degrees when written.  Random numbers come from splitmix64
+// rather than <random>, whose distributions differ between standard
+// libraries, so a seed means the same feed everywhere.
+//
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include "synthetic_gtfs.h"
+
+using namespace std;
+
+const double PI = 3.14159265358979323846;
+const double FEET_PER_DEGREE_LAT = 364000;
+const double BUS_FEET_PER_SECOND = 30;     // About 20 miles per hour, between stops
+const int DWELL_SECONDS = 20;
+const int FIRST_DEPARTURE = 5 * 3600;      // Service runs 05:00 ...
+const int SERVICE_SECONDS = 18 * 3600;     // ... to 23:00
+
+Synthetic_Feed_Options default_synthetic_feed_options()
+{
+    return Synthetic_Feed_Options { 2500, 5000, 30, GRID, 33.75, -84.39, 1300, 1 };
+}
+
+static uint64_t next_random(uint64_t &state)
+{
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static double random_fraction(uint64_t &state)  // [0, 1)
+{
+    return (next_random(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static void lay_out_grid(const Synthetic_Feed_Options &options, uint64_t &state,
+                         vector<double> &x, vector<double> &y, vector<vector<int>> &lines)
+{
+    int side = (int) ceil(sqrt((double) options.stops));
+    for ( int stop = 0; stop < options.stops; stop++ ) {
+        double jitter_x = (random_fraction(state) - 0.5) * 0.2, jitter_y = (random_fraction(state) - 0.5) * 0.2;
+        x.push_back((stop % side - (side - 1) / 2.0 + jitter_x) * options.stop_spacing);
+        y.push_back((stop / side - (side - 1) / 2.0 + jitter_y) * options.stop_spacing);
+    }
+
+    for ( int row = 0; row < side; row++ ) {
+        vector<int> line;
+        for ( int stop = row * side; stop < min(options.stops, (row + 1) * side); stop++ ) {
+            line.push_back(stop);
+        }
+        lines.push_back(line);
+    }
+    for ( int column = 0; column < side; column++ ) {
+        vector<int> line;
+        for ( int stop = column; stop < options.stops; stop += side ) {
+            line.push_back(stop);
+        }
+        lines.push_back(line);
+    }
+}
+
+static void lay_out_radial(const Synthetic_Feed_Options &options, uint64_t &state,
+                           vector<double> &x, vector<double> &y, vector<vector<int>> &lines)
+{
+    int spokes = max(4, (int) sqrt((double) options.stops) & ~1);
+    int rings = (options.stops + spokes - 1) / spokes;
+    for ( int stop = 0; stop < options.stops; stop++ ) {
+        double angle = 2 * PI * (stop % spokes + (random_fraction(state) - 0.5) * 0.1) / spokes;
+        double radius = (stop / spokes + 1 + (random_fraction(state) - 0.5) * 0.2) * options.stop_spacing;
+        x.push_back(radius * cos(angle));
+        y.push_back(radius * sin(angle));
+    }
+
+    //
+    // Through the center: in along one spoke, out along the opposite one
+    //
+    for ( int spoke = 0; spoke < spokes / 2; spoke++ ) {
+        vector<int> line;
+        for ( int ring = rings - 1; ring >= 0; ring-- ) {
+            if ( ring * spokes + spoke + spokes / 2 < options.stops ) {
+                line.push_back(ring * spokes + spoke + spokes / 2);
+            }
+        }
+        for ( int ring = 0; ring < rings; ring++ ) {
+            if ( ring * spokes + spoke < options.stops ) {
+                line.push_back(ring * spokes + spoke);
+            }
+        }
+        lines.push_back(line);
+    }
+    for ( int ring = 2; ring < rings; ring += 3 ) {
+        vector<int> line;
+        for ( int stop = ring * spokes; stop < min(options.stops, (ring + 1) * spokes); stop++ ) {
+            line.push_back(stop);
+        }
+        lines.push_back(line);
+    }
+}
+
+static string format_time(int seconds)
+{
+    char stamp[16];
+    snprintf(stamp, sizeof(stamp), "%02d:%02d:%02d", seconds / 3600, seconds / 60 % 60, seconds % 60);
+    return stamp;
+}
+
+bool write_synthetic_feed(const Synthetic_Feed_Options &options, string folder)
+{
+    uint64_t state = options.seed;
+    vector<double> x, y;
+    vector<vector<int>> lines;
+    if ( options.topology == GRID ) {
+        lay_out_grid(options, state, x, y, lines);
+    }
+    else {
+        lay_out_radial(options, state, x, y, lines);
+    }
+    lines.erase(remove_if(lines.begin(), lines.end(), [](const vector<int> &line) { return line.size() < 2; }), lines.end());
+
+    FILE *agency = fopen((folder + "/agency.txt").c_str(), "wb");
+    FILE *routes = fopen((folder + "/routes.txt").c_str(), "wb");
+    FILE *stops = fopen((folder + "/stops.txt").c_str(), "wb");
+    FILE *trips = fopen((folder + "/trips.txt").c_str(), "wb");
+    FILE *stop_times = fopen((folder + "/stop_times.txt").c_str(), "wb");
+    bool ok = agency && routes && stops && trips && stop_times;
+
+    if ( ok ) {
+        fprintf(agency, "agency_id,agency_name,agency_url,agency_timezone,agency_email\n");
+        fprintf(agency, "SYN,\"Synthetic Transit, %s\",http://example.com,America/New_York,synthetic@example.com\n",
+                options.topology == GRID ? "Grid" : "Radial");
+
+        fprintf(routes, "route_id,agency_id,route_short_name,route_long_name,route_desc,route_type\n");
+        for ( size_t line = 0; line < lines.size(); line++ ) {
+            fprintf(routes, "R%zu,SYN,%zu,Line %zu,\"%zu stops, end to end\",3\n", line, line, line, lines[line].size());
+        }
+
+        double feet_per_degree_lon = FEET_PER_DEGREE_LAT * cos(options.center_lat * PI / 180);
+        fprintf(stops, "stop_id,stop_code,stop_name,stop_lat,stop_lon\n");
+        for ( int stop = 0; stop < options.stops; stop++ ) {
+            fprintf(stops, "S%d,%d,\"Stop %d, Synthetic\",%.6f,%.6f\n", stop, stop, stop,
+                    options.center_lat + y[stop] / FEET_PER_DEGREE_LAT, options.center_lon + x[stop] / feet_per_degree_lon);
+        }
+
+        //
+        // Trip t runs on line t % lines; the runs on each line are
+        // spread evenly over the service day, alternating direction
+        //
+        fprintf(trips, "route_id,service_id,trip_id,trip_headsign\n");
+        fprintf(stop_times, "trip_id,arrival_time,departure_time,stop_id,stop_sequence\n");
+        int runs_per_line = lines.empty() ? 0 : (options.trips + lines.size() - 1) / lines.size();
+        for ( int trip = 0; trip < options.trips && !lines.empty(); trip++ ) {
+            const vector<int> &line = lines[trip % lines.size()];
+            int run = trip / lines.size();
+            int length = min<int>(max(2, options.stops_per_trip), line.size());
+            int first = next_random(state) % (line.size() - length + 1);
+            bool backward = run % 2 == 1;
+            int time = FIRST_DEPARTURE + (int) ((double) run * SERVICE_SECONDS / runs_per_line) + next_random(state) % 60;
+
+            int last_stop = line[backward ? first : first + length - 1];
+            fprintf(trips, "R%zu,DAILY,T%d,\"Line %zu, toward Stop %d\"\n", trip % lines.size(), trip, trip % lines.size(), last_stop);
+            for ( int sequence = 1; sequence <= length; sequence++ ) {
+                int position = backward ? first + length - sequence : first + sequence - 1;
+                int stop = line[position];
+                if ( sequence > 1 ) {
+                    int previous = line[backward ? position + 1 : position - 1];
+                    time += (int) ceil(hypot(x[stop] - x[previous], y[stop] - y[previous]) / BUS_FEET_PER_SECOND);
+                }
+                string arrive = format_time(time);
+                if ( sequence < length ) {
+                    time += DWELL_SECONDS;
+                }
+                fprintf(stop_times, "T%d,%s,%s,S%d,%d\n", trip, arrive.c_str(), format_time(time).c_str(), stop, sequence);
+            }
+        }
+    }
+
+    for ( FILE *file: { agency, routes, stops, trips, stop_times } ) {
+        if ( file ) {
+            ok = !ferror(file) && ok;
+            ok = fclose(file) == 0 && ok;
+        }
+    }
+    return ok;
+}
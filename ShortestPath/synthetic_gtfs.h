@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+//
+// Deterministic made-up transit systems, for benchmarking without
+// downloading a feed.  The same options (and seed) always produce
+// byte-for-byte the same files, on any platform.
+//
+//   GRID:    stops on a square lattice; every row and every column of
+//            the lattice is a line, like a street-grid bus system.
+//   RADIAL:  stops on spokes around a center; each pair of opposite
+//            spokes is a line through the center, and every third
+//            ring is a circular line, like a hub-and-spoke rail system.
+//
+// Each trip rides stops_per_trip consecutive stops of one line, in
+// either direction.  Trips on a line are spread over the service day.
+//
+enum synthetic_topologies
+{
+    GRID,
+    RADIAL
+};
+
+typedef struct _synthetic_feed_options
+{
+    int stops;
+    int trips;
+    int stops_per_trip;
+    synthetic_topologies topology;
+    double center_lat;
+    double center_lon;
+    double stop_spacing;       // Feet between neighboring stops
+    uint64_t seed;
+} Synthetic_Feed_Options;
+
+extern Synthetic_Feed_Options default_synthetic_feed_options();
+
+//
+// Writes agency.txt, routes.txt, stops.txt, trips.txt and stop_times.txt
+// into folder, which must exist.  Returns false if a file can't be written.
+//
+extern bool write_synthetic_feed(const Synthetic_Feed_Options &options, std::string folder);
@@ -0,0 +1,12 @@
+#
+# Build gtfs_test.exe and run the cross-checks on synthetic feeds
+# (written under test_data/).  Name checks to run only those.
+#
+cmd='g++ -std=c++17 -O2 tests.c++ synthetic_gtfs.c++ parse_gtfs.c++ parse_csv.c++ optimize_path.c++ stop_grid.c++ raptor.c++ snapshot.c++ -pthread -static-libgcc -static-libstdc++ -o gtfs_test.exe'
+echo $cmd
+if ! $cmd; then
+    echo Compile failed with status $?
+    exit 1
+fi
+
+./gtfs_test.exe "$@"
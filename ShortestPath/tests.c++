@@ -0,0 +1,1199 @@
+//
+// Cross-checks for gtfs_route, runnable offline
+//
+//   gtfs_test [--workdir folder] [check ...]
+//
+// Each search check runs a fast search against a slow, obviously
+// correct one on synthetic feeds (see synthetic_gtfs.h); the parsing
+// checks read hand-written input with known answers.  Every
+// disagreement is counted.  With no check named, all of them run.
+// Exits nonzero if any disagree.
+//
+//   csv:     split_quoted_csv_line() and Csv_File on quoted fields,
+//            CRLF endings, empty last fields and unterminated quotes
+//   time:    parse_gtfs_time() and parse_gtfs_time_window() past
+//            midnight, on garbled stamps and on reversed windows
+//   grid:    find_stops_within_distance() against dist_feet() on every stop
+//   raptor:  raptor_earliest_arrival() against a Dijkstra search over
+//            (stop, how we got there, vehicles so far), with walking
+//            times computed from scratch
+//   profile: raptor_profile() against that search, run at the start
+//            times where its answers change, found by bisection
+//   snapshot: a compiled feed against the CSV parse, column by column
+//            and query by query; truncated, damaged, unreadable and
+//            stale snapshots must fall back to the CSV files
+//   slices:  stop_times.txt read in many slices against one slice, and
+//            errors in a later slice reported on their line of the file
+//
+
+#include <iostream>
+#include <getopt.h>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <queue>
+#include <tuple>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <sstream>
+#include <fstream>
+#include <math.h>
+#include <filesystem>
+#include <exception>
+#include <chrono>
+#include "parse_csv.h"
+#include "parse_gtfs.h"
+#include "optimize_path.h"
+#include "stop_grid.h"
+#include "raptor.h"
+#include "snapshot.h"
+#include "synthetic_gtfs.h"
+
+//
+// Only this many disagreements are described; the rest are just counted
+//
+const int REPORTED_FAILURES = 5;
+
+typedef struct _test_check
+{
+    const char *name;
+    int (*run)(const std::string &workdir);    // Returns the number of failures
+} Test_Check;
+
+//
+// Test queries need not be random, just varied; splitmix64 keeps them
+// the same from run to run and platform to platform
+//
+static double next_fraction(uint64_t &state)  // [0, 1)
+{
+    uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return ((z ^ (z >> 31)) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+//
+// Write a synthetic feed under workdir and load it, with the loader's
+// timing lines out of the way
+//
+static bool load_synthetic_feed(const Synthetic_Feed_Options &options, const std::string &folder, Timetable &timetable)
+{
+    std::error_code error;
+    std::filesystem::create_directories(folder, error);
+    if ( !write_synthetic_feed(options, folder) ) {
+        std::cerr << "Unable to write synthetic feed to <" << folder << ">" << std::endl;
+        return false;
+    }
+
+    std::ostringstream discard;
+    auto saved = std::cout.rdbuf(discard.rdbuf());
+    try {
+        load_gtfs_system_data(folder, timetable);
+    }
+    catch ( ... ) {
+        std::cout.rdbuf(saved);
+        throw;
+    }
+    std::cout.rdbuf(saved);
+    return true;
+}
+
+//
+// Write text to folder/filename, exactly as given (line endings and all)
+//
+static bool write_test_file(const std::string &folder, const std::string &filename, const std::string &text)
+{
+    std::error_code error;
+    std::filesystem::create_directories(folder, error);
+    std::ofstream out(folder + "/" + filename, std::ios::binary);
+    out << text;
+    out.close();
+    if ( !out ) {
+        std::cerr << "Unable to write <" << folder << "/" << filename << ">" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static std::string describe_fields(const std::vector<std::string> &fields)
+{
+    std::string text;
+    for ( const auto &field: fields ) {
+        text += (text.empty() ? "[" : "|[") + field + "]";
+    }
+    return text;
+}
+
+//
+// Lines in the shapes GTFS feeds actually use, each with the fields it
+// should split into.  Every line is split on its own, then all of them
+// are read back from a file with mixed line endings, which must agree.
+//
+static int check_csv(const std::string &workdir)
+{
+    const std::vector<std::pair<std::string, std::vector<std::string>>> cases {
+        { "route_id,agency_id,route_long_name", { "route_id", "agency_id", "route_long_name" } },
+        { "7694,110,\"Peachtree St./\"\"The Peach\"\"\",,3,,819FF7,",
+          { "7694", "110", "Peachtree St./\"The Peach\"", "", "3", "", "819FF7", "" } },
+        { "1,\"Five Points, Inbound\",\"a,\"\"b\"\",c\"", { "1", "Five Points, Inbound", "a,\"b\",c" } },
+        { " 2, \"spaced\" ,  three", { "2", "spaced ", "three" } },
+        { "\"\",x,", { "", "x", "" } },
+        { ",,", { "", "", "" } },
+        { "", { "" } },
+        { "last,", { "last", "" } }
+    };
+    int failures = 0, checks = 0;
+    auto fail = [&failures](const std::string &complaint) {
+        if ( ++failures <= REPORTED_FAILURES ) {
+            std::cout << "  csv: " << complaint << std::endl;
+        }
+    };
+
+    std::vector<std::string_view> fields;
+    std::string scratch, file_text;
+    for ( size_t i = 0; i < cases.size(); i++ ) {
+        const auto &[line, expected] = cases[i];
+        split_quoted_csv_line(line, fields, scratch);
+        std::vector<std::string> split(fields.begin(), fields.end());
+        checks++;
+        if ( split != expected ) {
+            fail("<" + line + "> split as " + describe_fields(split) + ", expected " + describe_fields(expected));
+        }
+        file_text += line + (i % 2 == 0 ? "\r\n" : "\n");
+    }
+
+    //
+    // From a file, where the header is taken apart from the body and
+    // every other line ends in CRLF, whose CR must not reach the fields
+    //
+    const std::string folder = workdir + "/csv";
+    if ( !write_test_file(folder, "lines.txt", file_text) ) {
+        return failures + 1;
+    }
+    Csv_File csv_file(folder, "lines.txt");
+    checks++;
+    if ( csv_file.columns() != cases[0].second ) {
+        fail("header read as " + describe_fields(csv_file.columns()));
+    }
+    size_t row_number = 1;
+    csv_file.for_each_row([&](const Csv_Row &row) {
+            std::vector<std::string> read;
+            for ( size_t column = 0; column < row.size(); column++ ) {
+                read.emplace_back(row[column]);
+            }
+            checks++;
+            if ( row_number >= cases.size() || read != cases[row_number].second ||
+                 row.line_number() != (long) row_number + 1 ) {
+                fail("line " + std::to_string(row.line_number()) + " read as " + describe_fields(read));
+            }
+            row_number++;
+        });
+    checks++;
+    if ( row_number != cases.size() ) {
+        fail("read " + std::to_string(row_number - 1) + " records, expected " + std::to_string(cases.size() - 1));
+    }
+
+    //
+    // An unterminated quote is refused, on its own and on line 4 of a
+    // file, where the line number must be reported
+    //
+    for ( std::string line: { "1,\"open", "\"", "a,\"b\"\",c" } ) {
+        checks++;
+        try {
+            split_quoted_csv_line(line, fields, scratch);
+            fail("<" + line + "> accepted");
+        }
+        catch ( const unterminated_quote_exception & ) {
+        }
+    }
+    if ( !write_test_file(folder, "unterminated.txt", "a,b\r\n1,2\r\n3,4\r\n5,\"six\r\n7,8\r\n") ) {
+        return failures + 1;
+    }
+    Csv_File bad_file(folder, "unterminated.txt");
+    Csv_Reader reader(bad_file.body_begin(), bad_file.body_end(), 2);
+    Csv_Row row;
+    checks++;
+    try {
+        while ( reader.next(row) ) {
+        }
+        fail("unterminated quote in a file accepted");
+    }
+    catch ( const unterminated_quote_exception & ) {
+        if ( row.line_number() != 4 ) {
+            fail("unterminated quote reported on line " + std::to_string(row.line_number()) + ", expected 4");
+        }
+    }
+    checks++;
+    std::ostringstream discard;
+    auto saved = std::cerr.rdbuf(discard.rdbuf());
+    try {
+        bad_file.for_each_row([](const Csv_Row &) {});
+        std::cerr.rdbuf(saved);
+        fail("for_each_row() accepted an unterminated quote");
+    }
+    catch ( const unterminated_quote_exception & ) {
+        std::cerr.rdbuf(saved);
+        if ( discard.str().find("line 4,") == std::string::npos ) {
+            fail("for_each_row() reported: " + discard.str());
+        }
+    }
+
+    std::cout << "csv: " << checks << " checks, " << failures << " mismatches" << std::endl;
+    return failures;
+}
+
+//
+// Stamps as feeds and users write them, past midnight included, and
+// the blank or garbled ones that must come back as NO_TIME.  Windows
+// must open no later than they close.
+//
+static int check_times(const std::string &)
+{
+    const std::vector<std::pair<std::string, Gtfs_Time>> stamps {
+        { "08:05:09", 8 * 3600 + 5 * 60 + 9 },
+        { "8:05:09", 8 * 3600 + 5 * 60 + 9 },
+        { "8:05", 8 * 3600 + 5 * 60 },
+        { "00:00:00", 0 },
+        { "23:59:59", 24 * 3600 - 1 },
+        { "24:00:00", 24 * 3600 },
+        { "25:10:00", 25 * 3600 + 10 * 60 },
+        { "47:59:59", 48 * 3600 - 1 },
+        { "08:05:09  ", 8 * 3600 + 5 * 60 + 9 },
+        { "", NO_TIME },
+        { " ", NO_TIME },
+        { "8", NO_TIME },
+        { "8:", NO_TIME },
+        { ":05", NO_TIME },
+        { "8:60", NO_TIME },
+        { "8:05:60", NO_TIME },
+        { "8:05:", NO_TIME },
+        { "-1:05", NO_TIME },
+        { "8:-5", NO_TIME },
+        { "8h05", NO_TIME },
+        { "8:05pm", NO_TIME },
+        { "8:05:09:10", NO_TIME },
+        { "1000:00", NO_TIME }
+    };
+    int failures = 0, checks = 0;
+    auto fail = [&failures](const std::string &complaint) {
+        if ( ++failures <= REPORTED_FAILURES ) {
+            std::cout << "  time: " << complaint << std::endl;
+        }
+    };
+
+    for ( const auto &[stamp, expected]: stamps ) {
+        Gtfs_Time parsed = parse_gtfs_time(stamp);
+        checks++;
+        if ( parsed != expected ) {
+            fail("<" + stamp + "> parsed as " + format_gtfs_time(parsed) + ", expected " + format_gtfs_time(expected));
+        }
+    }
+
+    const std::vector<std::tuple<std::string, Gtfs_Time, Gtfs_Time>> windows {
+        { "08:00-09:30", 8 * 3600, 9 * 3600 + 30 * 60 },
+        { "8:00:15-8:00:45", 8 * 3600 + 15, 8 * 3600 + 45 },
+        { "23:30-25:10:00", 23 * 3600 + 30 * 60, 25 * 3600 + 10 * 60 },
+        { "08:00-08:00", 8 * 3600, 8 * 3600 },
+        { "08:00", 8 * 3600, 8 * 3600 },
+        { "09:30-08:00", NO_TIME, NO_TIME },
+        { "25:10-01:10", NO_TIME, NO_TIME },
+        { "08:00-", NO_TIME, NO_TIME },
+        { "-09:30", NO_TIME, NO_TIME },
+        { "08:00-09:30-10:00", NO_TIME, NO_TIME },
+        { "08:00 to 09:30", NO_TIME, NO_TIME },
+        { "", NO_TIME, NO_TIME }
+    };
+    for ( const auto &[window, earliest, latest]: windows ) {
+        Gtfs_Time opens, closes;
+        bool accepted = parse_gtfs_time_window(window, opens, closes);
+        checks++;
+        if ( accepted != (earliest != NO_TIME) || (accepted && (opens != earliest || closes != latest)) ) {
+            fail("<" + window + "> " + (accepted ? "read as " + format_gtfs_time(opens) + "-" + format_gtfs_time(closes)
+                                                 : std::string("refused")));
+        }
+    }
+
+    std::cout << "time: " << checks << " checks, " << failures << " mismatches" << std::endl;
+    return failures;
+}
+
+static int check_stop_grid(const std::string &workdir)
+{
+    int failures = 0, queries = 0;
+    uint64_t state = 4;
+
+    for ( auto topology: { GRID, RADIAL } ) {
+        Synthetic_Feed_Options options = default_synthetic_feed_options();
+        options.topology = topology;
+        options.trips = 200;
+        Timetable timetable;
+        if ( !load_synthetic_feed(options, workdir + (topology == GRID ? "/grid" : "/radial"), timetable) ) {
+            return 1;
+        }
+
+        //
+        // Random points over and around the feed, and the stops
+        // themselves, where the boundary is exactly at other stops
+        //
+        const auto &stops = timetable.stops;
+        for ( int query = 0; query < 2000; query++ ) {
+            double lat, lon, distance;
+            if ( query % 2 == 0 ) {
+                lat = options.center_lat + (next_fraction(state) - 0.5) * 0.8;
+                lon = options.center_lon + (next_fraction(state) - 0.5) * 0.8;
+                distance = next_fraction(state) * 20000;
+            }
+            else {
+                const Stop &stop = stops[(size_t) (next_fraction(state) * stops.size())];
+                const Stop &other = stops[(size_t) (next_fraction(state) * stops.size())];
+                lat = stop.lat;
+                lon = stop.lon;
+                distance = dist_feet(lat, lon, other.lat, other.lon);
+            }
+
+            std::vector<Stop_Index> found, expected;
+            find_stops_within_distance(timetable, lat, lon, distance, found);
+            for ( Stop_Index stop = 0; stop < (Stop_Index) stops.size(); stop++ ) {
+                if ( dist_feet(lat, lon, stops[stop].lat, stops[stop].lon) < distance ) {
+                    expected.push_back(stop);
+                }
+            }
+            std::sort(found.begin(), found.end());
+            queries++;
+            if ( found != expected && ++failures <= REPORTED_FAILURES ) {
+                std::cout << "  grid: (" << lat << ", " << lon << ") within " << distance << " feet found "
+                          << found.size() << " stops, expected " << expected.size() << std::endl;
+            }
+        }
+    }
+
+    std::cout << "grid: " << queries << " radius queries, " << failures << " mismatches" << std::endl;
+    return failures;
+}
+
+//
+// The journeys RAPTOR looks for, spelled out as a graph: walk from the
+// start to any stop within route_buffer; board any timed departure at
+// least transfer_slack after getting off a vehicle or walking from one
+// (right away after walking from the start); get off at any later timed
+// stop; walk at most once between vehicles, to any stop within
+// route_buffer; and walk to the destination after the last vehicle.
+// Or walk all the way.  Walks are single hops: none follows another.
+//
+typedef struct _reference_router
+{
+    const Timetable &timetable;
+    double route_buffer;
+    Gtfs_Time transfer_slack;
+    std::vector<std::vector<std::pair<Stop_Index, Gtfs_Time>>> walks;   // Every stop within route_buffer of each stop
+} Reference_Router;
+
+enum reference_modes
+{
+    FROM_START,      // Walked from the starting point
+    BY_VEHICLE,
+    ON_FOOT,         // Walked from where a vehicle let us off
+    REFERENCE_MODES
+};
+
+static Gtfs_Time reference_walk_seconds(double feet)
+{
+    return (Gtfs_Time) ceil(feet / WALKING_FEET_PER_SECOND);
+}
+
+static Reference_Router make_reference_router(const Timetable &timetable, double route_buffer, double time_buffer)
+{
+    Reference_Router router { timetable, route_buffer, (Gtfs_Time) ceil(time_buffer * 60), {} };
+    const auto &stops = timetable.stops;
+    router.walks.resize(stops.size());
+    for ( Stop_Index from = 0; from < (Stop_Index) stops.size(); from++ ) {
+        for ( Stop_Index to = 0; to < (Stop_Index) stops.size(); to++ ) {
+            double feet = dist_feet(stops[from].lat, stops[from].lon, stops[to].lat, stops[to].lon);
+            if ( to != from && feet < route_buffer ) {
+                router.walks[from].push_back({ to, reference_walk_seconds(feet) });
+            }
+        }
+    }
+    return router;
+}
+
+//
+// arrivals[k] = earliest arrival at the destination with at most k
+// vehicles (k = 0 is walking all the way), or NO_TIME
+//
+static std::vector<Gtfs_Time> reference_arrivals(const Reference_Router &router, double start_lat, double start_lon,
+                                                 Gtfs_Time start_time, double dest_lat, double dest_lon, int max_vehicles)
+{
+    const Timetable &timetable = router.timetable;
+    const Stop_Times &stop_times = timetable.stop_times;
+    const auto &stops = timetable.stops;
+    size_t num_stops = stops.size();
+    std::vector<Gtfs_Time> arrivals(max_vehicles + 1, NO_TIME);
+    std::vector<Gtfs_Time> best((max_vehicles + 1) * REFERENCE_MODES * num_stops, NO_TIME);
+    std::vector<uint32_t> boarded((max_vehicles + 1) * timetable.trips.size(), UINT32_MAX);   // Earliest row boarded, per trip and vehicles
+    std::vector<Gtfs_Time> egress(num_stops, NO_TIME);
+
+    typedef std::tuple<Gtfs_Time, int, int, Stop_Index> Reference_State;   // time, vehicles, mode, stop
+    std::priority_queue<Reference_State, std::vector<Reference_State>, std::greater<Reference_State>> queue;
+    auto reach = [&](Gtfs_Time time, int vehicles, int mode, Stop_Index stop) {
+        Gtfs_Time &known = best[(vehicles * REFERENCE_MODES + mode) * num_stops + stop];
+        if ( time < known ) {
+            known = time;
+            queue.push(Reference_State { time, vehicles, mode, stop });
+        }
+    };
+
+    double direct_feet = dist_feet(start_lat, start_lon, dest_lat, dest_lon);
+    if ( direct_feet < router.route_buffer ) {
+        arrivals[0] = start_time + reference_walk_seconds(direct_feet);
+    }
+    for ( Stop_Index stop = 0; stop < (Stop_Index) num_stops; stop++ ) {
+        double feet = dist_feet(start_lat, start_lon, stops[stop].lat, stops[stop].lon);
+        if ( feet < router.route_buffer ) {
+            reach(start_time + reference_walk_seconds(feet), 0, FROM_START, stop);
+        }
+        feet = dist_feet(stops[stop].lat, stops[stop].lon, dest_lat, dest_lon);
+        if ( feet < router.route_buffer ) {
+            egress[stop] = reference_walk_seconds(feet);
+        }
+    }
+
+    while ( !queue.empty() ) {
+        auto [time, vehicles, mode, stop] = queue.top();
+        queue.pop();
+        if ( time != best[(vehicles * REFERENCE_MODES + mode) * num_stops + stop] ) {
+            continue;
+        }
+
+        if ( mode != FROM_START && egress[stop] != NO_TIME ) {
+            arrivals[vehicles] = std::min(arrivals[vehicles], time + egress[stop]);
+        }
+        if ( mode == BY_VEHICLE ) {
+            for ( auto walk: router.walks[stop] ) {
+                reach(time + walk.second, vehicles, ON_FOOT, walk.first);
+            }
+        }
+        if ( vehicles == max_vehicles ) {
+            continue;
+        }
+
+        Gtfs_Time ready = time + (mode == FROM_START ? 0 : router.transfer_slack);
+        for ( uint32_t slot = timetable.stop_offsets[stop]; slot < timetable.stop_offsets[stop + 1]; slot++ ) {
+            uint32_t row = timetable.stop_departures[slot];
+            Trip_Index trip = stop_times.trip[row];
+            uint32_t trip_end = timetable.trip_offsets[trip + 1];
+            uint32_t &first_boarded = boarded[vehicles * timetable.trips.size() + trip];
+            if ( stop_times.depart[row] == NO_TIME || stop_times.depart[row] < ready || row + 1 == trip_end || first_boarded <= row ) {
+                continue;
+            }
+            first_boarded = row;
+            for ( uint32_t later = row + 1; later < trip_end; later++ ) {
+                if ( stop_times.arrive[later] != NO_TIME ) {
+                    reach(stop_times.arrive[later], vehicles + 1, BY_VEHICLE, stop_times.stop[later]);
+                }
+            }
+        }
+    }
+
+    for ( int vehicles = 1; vehicles <= max_vehicles; vehicles++ ) {
+        arrivals[vehicles] = std::min(arrivals[vehicles], arrivals[vehicles - 1]);
+    }
+    return arrivals;
+}
+
+//
+// Empty if journey could actually be made, as the reference router
+// sees it; otherwise what's wrong with it
+//
+static std::string journey_problem(const Reference_Router &router, const Journey &journey,
+                                   double start_lat, double start_lon, double dest_lat, double dest_lon)
+{
+    const Timetable &timetable = router.timetable;
+    const Stop_Times &stop_times = timetable.stop_times;
+    int vehicles = 0;
+    Gtfs_Time at = journey.depart;
+    bool after_vehicle = false;
+
+    for ( size_t i = 0; i < journey.legs.size(); i++ ) {
+        const Journey_Leg &leg = journey.legs[i];
+        if ( leg.depart < at ) {
+            return "leg " + std::to_string(i) + " leaves before the one before it ends";
+        }
+        if ( leg.trip == NO_INDEX ) {
+            double from_lat = leg.from == NO_INDEX ? start_lat : timetable.stops[leg.from].lat;
+            double from_lon = leg.from == NO_INDEX ? start_lon : timetable.stops[leg.from].lon;
+            double to_lat = leg.to == NO_INDEX ? dest_lat : timetable.stops[leg.to].lat;
+            double to_lon = leg.to == NO_INDEX ? dest_lon : timetable.stops[leg.to].lon;
+            double feet = dist_feet(from_lat, from_lon, to_lat, to_lon);
+            if ( feet >= router.route_buffer || leg.arrive - leg.depart < reference_walk_seconds(feet) ) {
+                return "walk " + std::to_string(i) + " is too long or too fast";
+            }
+        }
+        else {
+            if ( after_vehicle && leg.depart < at + router.transfer_slack ) {
+                return "ride " + std::to_string(i) + " leaves without the transfer slack";
+            }
+            uint32_t board = UINT32_MAX, alight = UINT32_MAX;
+            for ( uint32_t row = timetable.trip_offsets[leg.trip]; row < timetable.trip_offsets[leg.trip + 1]; row++ ) {
+                if ( board == UINT32_MAX && stop_times.stop[row] == leg.from && stop_times.depart[row] == leg.depart ) {
+                    board = row;
+                }
+                else if ( board != UINT32_MAX && stop_times.stop[row] == leg.to && stop_times.arrive[row] == leg.arrive ) {
+                    alight = row;
+                    break;
+                }
+            }
+            if ( alight == UINT32_MAX ) {
+                return "ride " + std::to_string(i) + " is not in the timetable";
+            }
+            vehicles++;
+            after_vehicle = true;
+        }
+        at = leg.arrive;
+    }
+    if ( journey.arrive != at || journey.transfers != std::max(0, vehicles - 1) ) {
+        return "summary does not match the legs";
+    }
+    return "";
+}
+
+//
+// Random trips over a synthetic grid, with walks long enough to make
+// walking on between vehicles matter, with and without transfer slack
+//
+static int check_raptor(const std::string &workdir)
+{
+    int failures = 0, queries = 0;
+    const int max_transfers = 3;
+    uint64_t state = 5;
+
+    Synthetic_Feed_Options options = default_synthetic_feed_options();
+    options.stops = 900;
+    options.trips = 2000;
+    options.stops_per_trip = 20;
+    Timetable timetable;
+    if ( !load_synthetic_feed(options, workdir + "/raptor", timetable) ) {
+        return 1;
+    }
+
+    for ( double route_buffer: { 1000.0, 2500.0 } ) {
+        for ( double time_buffer: { 0.0, 15.0 } ) {
+            Raptor_Network network;
+            build_raptor_network(timetable, route_buffer, time_buffer, network);
+            Reference_Router router = make_reference_router(timetable, route_buffer, time_buffer);
+            Raptor_Scratch scratch;
+
+            for ( int query = 0; query < 150; query++ ) {
+                double start_lat = options.center_lat + (next_fraction(state) - 0.5) * 0.1;
+                double start_lon = options.center_lon + (next_fraction(state) - 0.5) * 0.1;
+                double dest_lat = options.center_lat + (next_fraction(state) - 0.5) * 0.1;
+                double dest_lon = options.center_lon + (next_fraction(state) - 0.5) * 0.1;
+                Gtfs_Time start_time = 6 * 3600 + (Gtfs_Time) (next_fraction(state) * 14 * 3600);
+
+                auto journeys = raptor_earliest_arrival(timetable, network, start_lat, start_lon, start_time,
+                                                        dest_lat, dest_lon, max_transfers, scratch);
+                auto arrivals = reference_arrivals(router, start_lat, start_lon, start_time, dest_lat, dest_lon, max_transfers + 1);
+
+                std::vector<std::pair<int, Gtfs_Time>> found, expected;
+                std::string problem;
+                for ( const auto &journey: journeys ) {
+                    bool walking = journey.legs.size() == 1;
+                    found.push_back({ walking ? -1 : journey.transfers, journey.arrive });
+                    if ( problem.empty() ) {
+                        problem = journey_problem(router, journey, start_lat, start_lon, dest_lat, dest_lon);
+                    }
+                }
+                if ( arrivals[0] != NO_TIME ) {
+                    expected.push_back({ -1, arrivals[0] });
+                }
+                for ( int vehicles = 1; vehicles <= max_transfers + 1; vehicles++ ) {
+                    if ( arrivals[vehicles] < arrivals[vehicles - 1] ) {
+                        expected.push_back({ vehicles - 1, arrivals[vehicles] });
+                    }
+                }
+
+                queries++;
+                if ( (found != expected || !problem.empty()) && ++failures <= REPORTED_FAILURES ) {
+                    std::cout << "  raptor: " << start_lat << " " << start_lon << " " << format_gtfs_time(start_time) << " "
+                              << dest_lat << " " << dest_lon << " (routebuff " << route_buffer << ", timebuff " << time_buffer << "): ";
+                    if ( !problem.empty() ) {
+                        std::cout << problem;
+                    }
+                    for ( auto journey: found ) {
+                        std::cout << " found " << format_gtfs_time(journey.second) << "/" << journey.first;
+                    }
+                    for ( auto journey: expected ) {
+                        std::cout << " expected " << format_gtfs_time(journey.second) << "/" << journey.first;
+                    }
+                    std::cout << std::endl;
+                }
+            }
+        }
+    }
+
+    std::cout << "raptor: " << queries << " queries, " << failures << " mismatches" << std::endl;
+    return failures;
+}
+
+//
+// The profile over [earliest_start, latest_start], from the reference
+// router alone: (departure, arrival, transfers) of every journey no
+// other beats on all three.  The earliest arrival with k vehicles only
+// gets later as the start time does, so each arrival it takes has a
+// latest start, found by bisection; those are the departures.  Start
+// times after the window aren't tried, so journeys leaving after it
+// are compared as if leaving at its close.
+//
+static std::set<std::tuple<Gtfs_Time, Gtfs_Time, int>> reference_profile(const Reference_Router &router,
+                                                                         double start_lat, double start_lon,
+                                                                         Gtfs_Time earliest_start, Gtfs_Time latest_start,
+                                                                         double dest_lat, double dest_lon, int max_vehicles)
+{
+    std::map<Gtfs_Time, std::vector<Gtfs_Time>> known;
+    auto arrival = [&](Gtfs_Time start_time, int vehicles) {
+        auto found = known.find(start_time);
+        if ( found == known.end() ) {
+            found = known.emplace(start_time, reference_arrivals(router, start_lat, start_lon, start_time,
+                                                                 dest_lat, dest_lon, max_vehicles)).first;
+        }
+        return found->second[vehicles];
+    };
+
+    std::vector<std::tuple<Gtfs_Time, Gtfs_Time, int>> steps;
+    for ( int vehicles = 1; vehicles <= max_vehicles; vehicles++ ) {
+        Gtfs_Time start_time = earliest_start;
+        while ( start_time <= latest_start ) {
+            Gtfs_Time arrive = arrival(start_time, vehicles);
+            if ( arrive == NO_TIME ) {
+                break;
+            }
+            Gtfs_Time low = start_time, high = arrive;   // arrival(low) == arrive; the latest start is no later than that
+            while ( low < high ) {
+                Gtfs_Time middle = low + (high - low + 1) / 2;
+                if ( arrival(middle, vehicles) == arrive ) {
+                    low = middle;
+                }
+                else {
+                    high = middle - 1;
+                }
+            }
+            steps.push_back({ std::min(low, latest_start), arrive, vehicles });
+            start_time = low + 1;
+        }
+    }
+
+    //
+    // Walking all the way, leaving as late as the journey, beats a
+    // journey that arrives no sooner
+    //
+    std::set<std::tuple<Gtfs_Time, Gtfs_Time, int>> profile;
+    for ( const auto &step: steps ) {
+        auto [depart, arrive, vehicles] = step;
+        if ( arrival(depart, 0) != NO_TIME && arrival(depart, 0) <= arrive ) {
+            continue;
+        }
+        bool beaten = std::any_of(steps.begin(), steps.end(), [&step, depart = depart, arrive = arrive, vehicles = vehicles](const auto &other) {
+                return other != step && std::get<0>(other) >= depart && std::get<1>(other) <= arrive && std::get<2>(other) <= vehicles;
+            });
+        if ( !beaten ) {
+            profile.insert({ depart, arrive, vehicles - 1 });
+        }
+    }
+    return profile;
+}
+
+//
+// Windows of up to an hour and a half, on the feed and walking limits
+// of the raptor check.  A journey found for the close of the window
+// may leave after it; which of several equally good ones is found is
+// up to the search, so it is compared as leaving at the close.
+//
+static int check_profile(const std::string &workdir)
+{
+    int failures = 0, queries = 0;
+    const int max_transfers = 3;
+    uint64_t state = 10;
+
+    Synthetic_Feed_Options options = default_synthetic_feed_options();
+    options.stops = 900;
+    options.trips = 2000;
+    options.stops_per_trip = 20;
+    Timetable timetable;
+    if ( !load_synthetic_feed(options, workdir + "/raptor", timetable) ) {
+        return 1;
+    }
+
+    for ( double route_buffer: { 1000.0, 2500.0 } ) {
+        for ( double time_buffer: { 0.0, 15.0 } ) {
+            Raptor_Network network;
+            build_raptor_network(timetable, route_buffer, time_buffer, network);
+            Reference_Router router = make_reference_router(timetable, route_buffer, time_buffer);
+            Raptor_Scratch scratch;
+
+            for ( int query = 0; query < 15; query++ ) {
+                double start_lat = options.center_lat + (next_fraction(state) - 0.5) * 0.1;
+                double start_lon = options.center_lon + (next_fraction(state) - 0.5) * 0.1;
+                double dest_lat = options.center_lat + (next_fraction(state) - 0.5) * 0.1;
+                double dest_lon = options.center_lon + (next_fraction(state) - 0.5) * 0.1;
+                Gtfs_Time earliest_start = 6 * 3600 + (Gtfs_Time) (next_fraction(state) * 14 * 3600);
+                Gtfs_Time latest_start = earliest_start + (Gtfs_Time) (next_fraction(state) * 90 * 60);
+
+                auto journeys = raptor_profile(timetable, network, start_lat, start_lon, earliest_start, latest_start,
+                                               dest_lat, dest_lon, max_transfers, scratch);
+                auto expected = reference_profile(router, start_lat, start_lon, earliest_start, latest_start,
+                                                  dest_lat, dest_lon, max_transfers + 1);
+
+                std::set<std::tuple<Gtfs_Time, Gtfs_Time, int>> found;
+                std::string problem;
+                bool in_order = true;
+                size_t rides = 0;
+                for ( size_t i = 0; i < journeys.size(); i++ ) {
+                    const Journey &journey = journeys[i];
+                    if ( journey.legs.size() == 1 ) {
+                        continue;
+                    }
+                    rides++;
+                    found.insert({ std::min(journey.depart, latest_start), journey.arrive, journey.transfers });
+                    in_order &= i == 0 || journeys[i - 1].legs.size() == 1 || journeys[i - 1].depart <= journey.depart;
+                    if ( problem.empty() ) {
+                        problem = journey_problem(router, journey, start_lat, start_lon, dest_lat, dest_lon);
+                    }
+                }
+                if ( !in_order ) {
+                    problem = "journeys out of order";
+                }
+                if ( rides != found.size() ) {
+                    problem = "the same journey more than once";
+                }
+                bool walks = !journeys.empty() && journeys[0].legs.size() == 1;
+                if ( walks != (reference_arrivals(router, start_lat, start_lon, earliest_start, dest_lat, dest_lon, 0)[0] != NO_TIME) ) {
+                    problem = "walking all the way wrongly " + std::string(walks ? "listed" : "left out");
+                }
+
+                queries++;
+                if ( (found != expected || !problem.empty()) && ++failures <= REPORTED_FAILURES ) {
+                    std::cout << "  profile: " << start_lat << " " << start_lon << " " << format_gtfs_time(earliest_start) << "-"
+                              << format_gtfs_time(latest_start) << " " << dest_lat << " " << dest_lon << " (routebuff "
+                              << route_buffer << ", timebuff " << time_buffer << "): " << problem << std::endl;
+                    for ( auto journey: found ) {
+                        if ( !expected.count(journey) ) {
+                            std::cout << "    extra " << format_gtfs_time(std::get<0>(journey)) << "-"
+                                      << format_gtfs_time(std::get<1>(journey)) << "/" << std::get<2>(journey) << std::endl;
+                        }
+                    }
+                    for ( auto journey: expected ) {
+                        if ( !found.count(journey) ) {
+                            std::cout << "    missing " << format_gtfs_time(std::get<0>(journey)) << "-"
+                                      << format_gtfs_time(std::get<1>(journey)) << "/" << std::get<2>(journey) << std::endl;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    std::cout << "profile: " << queries << " windows, " << failures << " mismatches" << std::endl;
+    return failures;
+}
+
+//
+// The first table or column where two timetables differ, or "" if
+// they are the same throughout
+//
+template <typename T>
+static bool same_column(const Column<T> &a, const Column<T> &b)
+{
+    return std::equal(a.begin(), a.end(), b.begin(), b.end());
+}
+
+static std::string timetable_difference(const Timetable &a, const Timetable &b)
+{
+    auto same_agency = [](const Agency &x, const Agency &y) { return x.id == y.id && x.name == y.name && x.email == y.email; };
+    auto same_route = [](const Route &x, const Route &y) {
+        return x.id == y.id && x.short_name == y.short_name && x.long_name == y.long_name && x.desc == y.desc;
+    };
+    //
+    // Placeholders for stops that stops.txt never defines sit at NaN
+    //
+    auto same_position = [](double x, double y) { return x == y || (std::isnan(x) && std::isnan(y)); };
+    auto same_stop = [&same_position](const Stop &x, const Stop &y) {
+        return x.id == y.id && x.code == y.code && x.name == y.name && same_position(x.lat, y.lat) && same_position(x.lon, y.lon);
+    };
+    auto same_trip = [](const Trip &x, const Trip &y) { return x.route == y.route && x.id == y.id && x.headsign == y.headsign; };
+
+    const Stop_Grid &grid = a.stop_grid, &other_grid = b.stop_grid;
+    const std::vector<std::pair<const char *, bool>> tables {
+        { "agencies", std::equal(a.agencies.begin(), a.agencies.end(), b.agencies.begin(), b.agencies.end(), same_agency) },
+        { "routes", std::equal(a.routes.begin(), a.routes.end(), b.routes.begin(), b.routes.end(), same_route) },
+        { "stops", std::equal(a.stops.begin(), a.stops.end(), b.stops.begin(), b.stops.end(), same_stop) },
+        { "trips", std::equal(a.trips.begin(), a.trips.end(), b.trips.begin(), b.trips.end(), same_trip) },
+        { "route_index", a.route_index == b.route_index },
+        { "stop_index", a.stop_index == b.stop_index },
+        { "trip_index", a.trip_index == b.trip_index },
+        { "stop_times.trip", same_column(a.stop_times.trip, b.stop_times.trip) },
+        { "stop_times.stop", same_column(a.stop_times.stop, b.stop_times.stop) },
+        { "stop_times.arrive", same_column(a.stop_times.arrive, b.stop_times.arrive) },
+        { "stop_times.depart", same_column(a.stop_times.depart, b.stop_times.depart) },
+        { "stop_times.sequence", same_column(a.stop_times.sequence, b.stop_times.sequence) },
+        { "trip_offsets", same_column(a.trip_offsets, b.trip_offsets) },
+        { "stop_offsets", same_column(a.stop_offsets, b.stop_offsets) },
+        { "stop_departures", same_column(a.stop_departures, b.stop_departures) },
+        { "stop_grid shape", grid.south == other_grid.south && grid.west == other_grid.west &&
+                             grid.cell_degrees == other_grid.cell_degrees && grid.rows == other_grid.rows &&
+                             grid.columns == other_grid.columns },
+        { "stop_grid.cell_offsets", same_column(grid.cell_offsets, other_grid.cell_offsets) },
+        { "stop_grid.stop", same_column(grid.stop, other_grid.stop) },
+        { "stop_grid.x", same_column(grid.x, other_grid.x) },
+        { "stop_grid.y", same_column(grid.y, other_grid.y) },
+        { "stop_grid.z", same_column(grid.z, other_grid.z) }
+    };
+    for ( const auto &[name, same]: tables ) {
+        if ( !same ) {
+            return name;
+        }
+    }
+    return "";
+}
+
+static std::string describe_journeys(const std::vector<Journey> &journeys)
+{
+    std::ostringstream text;
+    for ( const auto &journey: journeys ) {
+        text << " " << format_gtfs_time(journey.depart) << "-" << format_gtfs_time(journey.arrive) << "/" << journey.transfers;
+        for ( const auto &leg: journey.legs ) {
+            text << " " << leg.trip << ":" << leg.from << ">" << leg.to;
+        }
+    }
+    return text.str();
+}
+
+//
+// Load folder the way gtfs_route does, with the commentary (and any
+// complaints about the snapshot) out of the way
+//
+static bool quietly_load_timetable(const std::string &folder, bool compile, Timetable &timetable)
+{
+    std::ostringstream discard;
+    auto saved_out = std::cout.rdbuf(discard.rdbuf());
+    auto saved_err = std::cerr.rdbuf(discard.rdbuf());
+    bool loaded = false;
+    try {
+        loaded = load_gtfs_timetable(folder, compile, timetable);
+    }
+    catch ( ... ) {
+        std::cout.rdbuf(saved_out);
+        std::cerr.rdbuf(saved_err);
+        throw;
+    }
+    std::cout.rdbuf(saved_out);
+    std::cerr.rdbuf(saved_err);
+    return loaded;
+}
+
+//
+// A compiled feed must load back column for column as the CSV parse
+// did, and answer queries the same.  A truncated, damaged, unreadable
+// or stale snapshot must be passed over for the CSV files.
+//
+static int check_snapshot(const std::string &workdir)
+{
+    int failures = 0, checks = 0;
+    uint64_t state = 6;
+    auto fail = [&failures](const std::string &complaint) {
+        if ( ++failures <= REPORTED_FAILURES ) {
+            std::cout << "  snapshot: " << complaint << std::endl;
+        }
+    };
+
+    Synthetic_Feed_Options options = default_synthetic_feed_options();
+    options.stops = 600;
+    options.trips = 800;
+    const std::string folder = workdir + "/snapshot";
+    const std::string snapshot_path = folder + "/" + SNAPSHOT_FILENAME;
+    std::error_code error;
+    std::filesystem::remove_all(snapshot_path, error);
+    Timetable parsed;
+    if ( !load_synthetic_feed(options, folder, parsed) ) {
+        return 1;
+    }
+
+    Timetable compiled, mapped;
+    quietly_load_timetable(folder, true, compiled);
+    quietly_load_timetable(folder, false, mapped);
+    checks++;
+    if ( !mapped.snapshot ) {
+        fail("compiled snapshot was not used");
+    }
+    std::string difference = timetable_difference(parsed, mapped);
+    checks++;
+    if ( !difference.empty() ) {
+        fail("snapshot differs from the CSV files in " + difference);
+    }
+
+    Raptor_Network parsed_network, mapped_network;
+    build_raptor_network(parsed, 2500, 0, parsed_network);
+    build_raptor_network(mapped, 2500, 0, mapped_network);
+    Raptor_Scratch parsed_scratch, mapped_scratch;
+    for ( int query = 0; query < 100; query++ ) {
+        double start_lat = options.center_lat + (next_fraction(state) - 0.5) * 0.1;
+        double start_lon = options.center_lon + (next_fraction(state) - 0.5) * 0.1;
+        double dest_lat = options.center_lat + (next_fraction(state) - 0.5) * 0.1;
+        double dest_lon = options.center_lon + (next_fraction(state) - 0.5) * 0.1;
+        Gtfs_Time start_time = 6 * 3600 + (Gtfs_Time) (next_fraction(state) * 14 * 3600);
+        auto expected = describe_journeys(raptor_earliest_arrival(parsed, parsed_network, start_lat, start_lon, start_time,
+                                                                  dest_lat, dest_lon, 3, parsed_scratch));
+        auto found = describe_journeys(raptor_earliest_arrival(mapped, mapped_network, start_lat, start_lon, start_time,
+                                                               dest_lat, dest_lon, 3, mapped_scratch));
+        checks++;
+        if ( found != expected ) {
+            fail("query from " + format_gtfs_time(start_time) + " answered" + found + ", expected" + expected);
+        }
+    }
+
+    //
+    // Each kind of bad snapshot, made from a copy of the good one
+    //
+    std::ifstream in(snapshot_path, std::ios::binary);
+    const std::string good((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    const std::vector<std::string> damages { "truncated", "checksum byte flipped", "body byte flipped", "unreadable", "stale" };
+    for ( const auto &damage: damages ) {
+        std::string bytes = good;
+        if ( damage == "truncated" ) {
+            bytes.resize(bytes.size() * 2 / 3);
+        }
+        else if ( damage == "checksum byte flipped" ) {
+            bytes[16] ^= 0x10;   // Snapshot_Header: magic, version, byte order, then checksum
+        }
+        else if ( damage == "body byte flipped" ) {
+            bytes[bytes.size() / 2] ^= 0x01;
+        }
+        std::filesystem::remove_all(snapshot_path, error);
+        if ( damage == "unreadable" ) {
+            std::filesystem::create_directory(snapshot_path, error);
+        }
+        else if ( !write_test_file(folder, SNAPSHOT_FILENAME, bytes) ) {
+            return failures + 1;
+        }
+
+        //
+        // Only the stale snapshot is older than the CSV files
+        //
+        auto snapshot_time = std::filesystem::last_write_time(snapshot_path, error);
+        auto source_time = snapshot_time + std::chrono::seconds(damage == "stale" ? 60 : -60);
+        for ( auto filename: { "agency.txt", "routes.txt", "stops.txt", "trips.txt", "stop_times.txt" } ) {
+            std::filesystem::last_write_time(folder + "/" + filename, source_time, error);
+        }
+
+        Timetable fallback;
+        bool loaded = false;
+        try {
+            loaded = quietly_load_timetable(folder, false, fallback);
+        }
+        catch ( const std::exception &e ) {
+            fail(damage + " snapshot: load threw " + e.what());
+            continue;
+        }
+        checks++;
+        if ( !loaded || fallback.snapshot ) {
+            fail(damage + " snapshot was " + (loaded ? "used" : "not replaced by the CSV files"));
+        }
+        else if ( !(difference = timetable_difference(parsed, fallback)).empty() ) {
+            fail(damage + " snapshot: CSV load differs in " + difference);
+        }
+    }
+    std::filesystem::remove_all(snapshot_path, error);
+
+    std::cout << "snapshot: " << checks << " checks, " << failures << " mismatches" << std::endl;
+    return failures;
+}
+
+//
+// Load folder with stop_times.txt cut into at most max_slices slices,
+// returning how many it was cut into (from the loader's timing line)
+// and anything written to cerr
+//
+static size_t load_in_slices(const std::string &folder, size_t max_slices, Timetable &timetable, std::string &complaints)
+{
+    std::ostringstream out, err;
+    auto saved_out = std::cout.rdbuf(out.rdbuf());
+    auto saved_err = std::cerr.rdbuf(err.rdbuf());
+    try {
+        load_gtfs_system_data(folder, timetable, max_slices, 1);
+    }
+    catch ( ... ) {
+        std::cout.rdbuf(saved_out);
+        std::cerr.rdbuf(saved_err);
+        complaints = err.str();
+        throw;
+    }
+    std::cout.rdbuf(saved_out);
+    std::cerr.rdbuf(saved_err);
+    complaints = err.str();
+
+    size_t slices = 0;
+    size_t found = out.str().find(" slices)");
+    if ( found != std::string::npos ) {
+        size_t open = out.str().rfind('(', found);
+        slices = std::stoul(out.str().substr(open + 1, found - open - 1));
+    }
+    return slices;
+}
+
+//
+// stop_times.txt read in many slices must give the same Timetable as
+// in one, even with trips split across slices and ids first seen in a
+// later slice (a few rows for unknown trips and stops are spliced in
+// mid-file, so placeholders must come out in file order too).  An
+// error in a later slice must be reported on its line of the file.
+//
+static int check_slices(const std::string &workdir)
+{
+    int failures = 0, checks = 0;
+    auto fail = [&failures](const std::string &complaint) {
+        if ( ++failures <= REPORTED_FAILURES ) {
+            std::cout << "  slices: " << complaint << std::endl;
+        }
+    };
+
+    Synthetic_Feed_Options options = default_synthetic_feed_options();
+    options.stops = 400;
+    options.trips = 300;
+    const std::string folder = workdir + "/slices";
+    std::error_code error;
+    std::filesystem::create_directories(folder, error);
+    if ( !write_synthetic_feed(options, folder) ) {
+        std::cerr << "Unable to write synthetic feed to <" << folder << ">" << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> lines;
+    {
+        std::ifstream in(folder + "/stop_times.txt", std::ios::binary);
+        for ( std::string line; std::getline(in, line); ) {
+            lines.push_back(line);
+        }
+    }
+    for ( size_t part: { 3, 2 } ) {
+        size_t at = lines.size() * (part - 1) / part;
+        lines.insert(lines.begin() + at, { "X" + std::to_string(part) + ",08:00:00,08:01:00,ZS" + std::to_string(part) + ",1",
+                                           "T0,09:00:00,09:00:00,ZS" + std::to_string(part) + ",99" });
+    }
+    auto write_stop_times = [&folder, &lines]() {
+        std::string text;
+        for ( const auto &line: lines ) {
+            text += line + "\n";
+        }
+        return write_test_file(folder, "stop_times.txt", text);
+    };
+    if ( !write_stop_times() ) {
+        return 1;
+    }
+
+    Timetable whole;
+    std::string complaints;
+    if ( load_in_slices(folder, 1, whole, complaints) != 1 ) {
+        fail("one slice asked for, more given");
+    }
+    for ( size_t max_slices: { 2, 3, 7, 16, 64 } ) {
+        Timetable sliced;
+        size_t slices = load_in_slices(folder, max_slices, sliced, complaints);
+        std::string difference = timetable_difference(whole, sliced);
+        checks++;
+        if ( slices < 2 ) {
+            fail("asked for " + std::to_string(max_slices) + " slices, got " + std::to_string(slices));
+        }
+        else if ( !difference.empty() ) {
+            fail(std::to_string(slices) + " slices differ from one in " + difference);
+        }
+    }
+
+    //
+    // Break a line near the end, well past the first slice, both ways
+    // the loader complains about a line
+    //
+    size_t broken = lines.size() - lines.size() / 5;
+    std::string saved = lines[broken];
+    for ( std::string damage: { "unterminated", "missing" } ) {
+        lines[broken] = damage == "unterminated" ? "\"" + saved : saved.substr(0, saved.find(',') + 1);
+        if ( !write_stop_times() ) {
+            return failures + 1;
+        }
+        Timetable timetable;
+        std::string expected = "line " + std::to_string(broken + 1) + (damage == "unterminated" ? ", " : ": ");
+        checks++;
+        try {
+            load_in_slices(folder, 16, timetable, complaints);
+            fail(damage + " field on line " + std::to_string(broken + 1) + " accepted");
+        }
+        catch ( const std::exception & ) {
+            if ( complaints.find(expected) == std::string::npos ) {
+                fail(damage + " field on line " + std::to_string(broken + 1) + " reported as: " + complaints);
+            }
+        }
+    }
+    lines[broken] = saved;
+
+    std::cout << "slices: " << checks << " checks, " << failures << " mismatches" << std::endl;
+    return failures;
+}
+
+static std::vector<Test_Check> test_checks()
+{
+    return {
+        { "csv", check_csv },
+        { "time", check_times },
+        { "grid", check_stop_grid },
+        { "raptor", check_raptor },
+        { "profile", check_profile },
+        { "snapshot", check_snapshot },
+        { "slices", check_slices }
+    };
+}
+
+int main(int argc, char **argv)
+{
+    static struct option test_options[]
+        {
+            {"workdir", required_argument, 0, 'w'},
+            {0, 0, 0, 0}
+        };
+
+    int opt;
+    int option_index = 0;
+    std::string workdir { "test_data" };
+
+    while ((opt = getopt_long(argc, argv, "w:", test_options, &option_index)) != -1) {
+        switch(opt) {
+        case 'w':
+            workdir = optarg;
+            break;
+
+        default:
+            std::cerr << "Usage: gtfs_test [--workdir folder] [check ...]" << std::endl;
+            return -1;
+        }
+    }
+
+    std::vector<std::string> selected(argv + optind, argv + argc);
+    int failures = 0;
+    try {
+        for ( const auto &check: test_checks() ) {
+            if ( selected.empty() || std::find(selected.begin(), selected.end(), check.name) != selected.end() ) {
+                failures += check.run(workdir);
+            }
+        }
+    }
+    catch ( const std::exception &e ) {
+        std::cerr << "Tests failed with Exception: " << e.what() << std::endl;
+        return -5;
+    }
+
+    if ( failures > 0 ) {
+        std::cout << failures << " failure(s)." << std::endl;
+        return 1;
+    }
+    std::cout << "All checks passed." << std::endl;
+    return 0;
+}